@@ -1,38 +1,290 @@
 #include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <cstdio>
 #include <string>
 #include <vector>
 #include <limits>
 #include <iostream>
+#include <iterator>
 #include <ctime>
+#include <chrono>
+#include <list>
+#include <map>
+#include <queue>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AYS_X86
+#include <immintrin.h>
+#endif
 #define FMT_HEADER_ONLY
 #include <fmt/core.h>
 #include <fmt/format.h>
 
-#include "includes/levenshtein-sse.hpp"
-
+#ifdef AYS_LEMON // only needed for min_weight_matching_lemon, the reference solver
 #include <lemon/smart_graph.h>
 #include <lemon/network_simplex.h>
-#include <lemon/cost_scaling.h>
-#include <lemon/graph_to_eps.h>
+#endif
 
 typedef uint32_t AYS_fixture_id;
 typedef uint32_t AYS_provider_id;
 typedef uint32_t AYS_sport_id;
 typedef uint32_t AYS_bet_type_id;
 typedef float AYS_odd;
+typedef uint32_t AYS_event_id;
 
 typedef std::string AYS_participant;
 typedef bool (*AYS_fixture_comparison_func)(const struct AYS_fixture&, const struct AYS_fixture&);
 
 struct AYS_fixture;
 struct AYS_event;
+struct AYS_match_cache;
 std::string AYS_event_to_string(const AYS_event event);
 std::string AYS_fixture_to_string(const AYS_fixture fixture);
-std::vector<AYS_event> AYS_fixtures_to_events(std::vector<AYS_fixture> fs);
+std::vector<AYS_event> AYS_fixtures_to_events(std::vector<AYS_fixture> fs, bool includeLive, AYS_match_cache *cache, int threads);
 #ifndef AYS_IMPLEMENTATION
 #define AYS_IMPLEMENTATION  
 
+/*
+ * Scan instrumentation, compiled in with -DAYS_STATS and compiled out (macros expand to nothing) otherwise.
+ * Counters and stage timers are relaxed atomics in one global AYS_stats so the parallel scan can update them
+ * without locks. Stage times are wall clock ns from steady_clock, similarity_sort latency (cache misses only,
+ * ie. Levenshtein matrix plus assignment) goes into a log2 histogram of AYS_STATS_BINS bins starting at 64ns.
+ * Read it with AYS_stats_get(), write it in Prometheus text format with AYS_stats_prometheus/AYS_stats_dump.
+ */
+#ifdef AYS_STATS
+enum AYS_stage {
+    AYS_STAGE_DEDUP,
+    AYS_STAGE_STORE,
+    AYS_STAGE_FILTER,
+    AYS_STAGE_BUCKET,
+    AYS_STAGE_PRUNE,
+    AYS_STAGE_CLUSTER,
+    AYS_STAGE_ARB,
+    AYS_STAGE_SORT,
+    AYS_STAGE_SCAN, // the whole AYS_store_to_events
+    AYS_STAGE_COUNT
+};
+
+static const char *AYS_stage_names[AYS_STAGE_COUNT] = {"dedup", "store", "filter", "bucket", "prune", "cluster", "arb", "sort", "scan"};
+
+#define AYS_STATS_BINS 16
+
+struct AYS_stats {
+    std::atomic<uint64_t> scans;
+    std::atomic<uint64_t> fixtures_scanned; // rows that passed the filter
+    std::atomic<uint64_t> fixtures_expired;
+    std::atomic<uint64_t> fixtures_live;
+    std::atomic<uint64_t> fixtures_oversized; // more than 3 participants
+    std::atomic<uint64_t> fixtures_duplicate; // dropped by AYS_dedup_batch, same content as a later quote of the batch
+    std::atomic<uint64_t> fixtures_superseded; // dropped by AYS_dedup_batch, a later quote of the batch replaces them
+    std::atomic<uint64_t> fixtures_unchanged; // kept by AYS_dedup_batch, same content as in the previous batch
+    std::atomic<uint64_t> buckets;
+    std::atomic<uint64_t> buckets_pruned; // skipped by the roi bound
+    std::atomic<uint64_t> buckets_reused; // clustering taken from the previous scan
+    std::atomic<uint64_t> similarity_calls;
+    std::atomic<uint64_t> similarity_cache_hits;
+    std::atomic<uint64_t> matching_solves;
+    std::atomic<uint64_t> matching_ties; // optima tied with another one, resolved like LEMON
+    std::atomic<uint64_t> threshold_rejections; // similarity above the 0.25 cutoff
+    std::atomic<uint64_t> events;
+    std::atomic<uint64_t> events_positive_roi;
+    std::atomic<uint64_t> events_reused; // arb results taken from the previous scan
+    std::atomic<uint64_t> stage_ns[AYS_STAGE_COUNT];
+    std::atomic<uint64_t> stage_runs[AYS_STAGE_COUNT];
+    std::atomic<uint64_t> matching_ns_bins[AYS_STATS_BINS+1]; // bin b counts latencies <= 64<<b ns, the last one the rest
+    std::atomic<uint64_t> matching_ns_sum;
+};
+
+AYS_stats &AYS_stats_get(){
+    static AYS_stats stats; // zero initialized, static storage
+    return stats;
+}
+
+void AYS_stats_reset(){
+    AYS_stats &s = AYS_stats_get();
+    std::atomic<uint64_t> *counters[] = {&s.scans, &s.fixtures_scanned, &s.fixtures_expired, &s.fixtures_live, &s.fixtures_oversized, 
+                                         &s.fixtures_duplicate, &s.fixtures_superseded, &s.fixtures_unchanged, 
+                                         &s.buckets, &s.buckets_pruned, &s.buckets_reused, &s.similarity_calls, &s.similarity_cache_hits, &s.matching_solves, &s.matching_ties, 
+                                         &s.threshold_rejections, &s.events, &s.events_positive_roi, &s.events_reused, &s.matching_ns_sum};
+    for (auto counter : counters){
+        counter->store(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < AYS_STAGE_COUNT; i++){
+        s.stage_ns[i].store(0, std::memory_order_relaxed);
+        s.stage_runs[i].store(0, std::memory_order_relaxed);
+    }
+    for (int b = 0; b <= AYS_STATS_BINS; b++){
+        s.matching_ns_bins[b].store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t AYS_stats_now(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void AYS_stats_matching_latency(uint64_t ns){
+    AYS_stats &s = AYS_stats_get();
+    int b = 0;
+    while (b < AYS_STATS_BINS && ns > (64ull << b)){
+        b++;
+    }
+    s.matching_ns_bins[b].fetch_add(1, std::memory_order_relaxed);
+    s.matching_ns_sum.fetch_add(ns, std::memory_order_relaxed);
+}
+
+// adds the lifetime of the timer to a stage
+struct AYS_stage_timer {
+    AYS_stage stage;
+    uint64_t start;
+    AYS_stage_timer(AYS_stage stage) : stage(stage), start(AYS_stats_now()) { }
+    ~AYS_stage_timer(){
+        AYS_stats &s = AYS_stats_get();
+        s.stage_ns[stage].fetch_add(AYS_stats_now()-start, std::memory_order_relaxed);
+        s.stage_runs[stage].fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+std::string AYS_stats_prometheus(const AYS_stats &s){
+    fmt::memory_buffer out;
+    auto counter = [&](const char *name, const char *help, const std::atomic<uint64_t> &value){
+        fmt::format_to(std::back_inserter(out), "# HELP ays_{0} {1}\n# TYPE ays_{0} counter\nays_{0} {2}\n", 
+                       name, help, value.load(std::memory_order_relaxed));
+    };
+    counter("scans_total", "Scans run.", s.scans);
+    counter("fixtures_scanned_total", "Fixtures that passed the filter.", s.fixtures_scanned);
+    fmt::format_to(std::back_inserter(out), "# HELP ays_fixtures_filtered_total Fixtures dropped by the filter.\n"
+                                            "# TYPE ays_fixtures_filtered_total counter\n");
+    fmt::format_to(std::back_inserter(out), "ays_fixtures_filtered_total{{reason=\"expired\"}} {}\n", s.fixtures_expired.load(std::memory_order_relaxed));
+    fmt::format_to(std::back_inserter(out), "ays_fixtures_filtered_total{{reason=\"live\"}} {}\n", s.fixtures_live.load(std::memory_order_relaxed));
+    fmt::format_to(std::back_inserter(out), "ays_fixtures_filtered_total{{reason=\"participants\"}} {}\n", s.fixtures_oversized.load(std::memory_order_relaxed));
+    fmt::format_to(std::back_inserter(out), "# HELP ays_fixtures_deduplicated_total Fixtures dropped or flagged by the dedup stage.\n"
+                                            "# TYPE ays_fixtures_deduplicated_total counter\n");
+    fmt::format_to(std::back_inserter(out), "ays_fixtures_deduplicated_total{{reason=\"duplicate\"}} {}\n", s.fixtures_duplicate.load(std::memory_order_relaxed));
+    fmt::format_to(std::back_inserter(out), "ays_fixtures_deduplicated_total{{reason=\"superseded\"}} {}\n", s.fixtures_superseded.load(std::memory_order_relaxed));
+    fmt::format_to(std::back_inserter(out), "ays_fixtures_deduplicated_total{{reason=\"unchanged\"}} {}\n", s.fixtures_unchanged.load(std::memory_order_relaxed));
+    counter("buckets_total", "Buckets produced by the bucketing stage.", s.buckets);
+    counter("buckets_pruned_total", "Buckets skipped because no event in them can reach the roi threshold.", s.buckets_pruned);
+    counter("buckets_reused_total", "Buckets whose clustering was reused from the previous scan.", s.buckets_reused);
+    counter("similarity_calls_total", "similarity_sort calls.", s.similarity_calls);
+    counter("similarity_cache_hits_total", "similarity_sort calls answered by the match cache.", s.similarity_cache_hits);
+    counter("matching_solves_total", "Assignment problems solved.", s.matching_solves);
+    counter("matching_ties_total", "Assignment problems with tied optima resolved like LEMON.", s.matching_ties);
+    counter("threshold_rejections_total", "Candidate pairs rejected by the 0.25 similarity cutoff.", s.threshold_rejections);
+    counter("events_total", "Events produced by scans.", s.events);
+    counter("events_positive_roi_total", "Events with a positive roi produced by scans.", s.events_positive_roi);
+    counter("events_reused_total", "Events whose arb results were reused from the previous scan.", s.events_reused);
+    fmt::format_to(std::back_inserter(out), "# HELP ays_stage_seconds_total Wall time spent per scan stage.\n"
+                                            "# TYPE ays_stage_seconds_total counter\n");
+    for (int i = 0; i < AYS_STAGE_COUNT; i++){
+        fmt::format_to(std::back_inserter(out), "ays_stage_seconds_total{{stage=\"{}\"}} {:.9f}\n", 
+                       AYS_stage_names[i], s.stage_ns[i].load(std::memory_order_relaxed)*1e-9);
+    }
+    fmt::format_to(std::back_inserter(out), "# HELP ays_stage_runs_total Runs per scan stage.\n"
+                                            "# TYPE ays_stage_runs_total counter\n");
+    for (int i = 0; i < AYS_STAGE_COUNT; i++){
+        fmt::format_to(std::back_inserter(out), "ays_stage_runs_total{{stage=\"{}\"}} {}\n", 
+                       AYS_stage_names[i], s.stage_runs[i].load(std::memory_order_relaxed));
+    }
+    fmt::format_to(std::back_inserter(out), "# HELP ays_matching_seconds Latency of similarity_sort cache misses.\n"
+                                            "# TYPE ays_matching_seconds histogram\n");
+    uint64_t cumulative = 0;
+    for (int b = 0; b < AYS_STATS_BINS; b++){
+        cumulative += s.matching_ns_bins[b].load(std::memory_order_relaxed);
+        fmt::format_to(std::back_inserter(out), "ays_matching_seconds_bucket{{le=\"{}\"}} {}\n", (64ull << b)*1e-9, cumulative);
+    }
+    cumulative += s.matching_ns_bins[AYS_STATS_BINS].load(std::memory_order_relaxed);
+    fmt::format_to(std::back_inserter(out), "ays_matching_seconds_bucket{{le=\"+Inf\"}} {}\n", cumulative);
+    fmt::format_to(std::back_inserter(out), "ays_matching_seconds_sum {:.9f}\n", s.matching_ns_sum.load(std::memory_order_relaxed)*1e-9);
+    fmt::format_to(std::back_inserter(out), "ays_matching_seconds_count {}\n", cumulative);
+    return fmt::to_string(out);
+}
+
+// writes the stats to path through a temporary file and a rename, so a scraper never reads a partial file
+bool AYS_stats_dump(const std::string &path){
+    std::string text = AYS_stats_prometheus(AYS_stats_get());
+    std::string tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "w");
+    if (!f){
+        std::cerr << "could not open " << tmp << std::endl;
+        return false;
+    }
+    bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0){
+        std::cerr << "could not write " << path << std::endl;
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+#define AYS_STAT_ADD(counter, n) AYS_stats_get().counter.fetch_add(n, std::memory_order_relaxed)
+#define AYS_STAT_TIMER(stage) AYS_stage_timer stage##_timer(stage)
+#define AYS_STAT_CLOCK(var) uint64_t var = AYS_stats_now()
+#define AYS_STAT_LATENCY(start) AYS_stats_matching_latency(AYS_stats_now()-(start))
+#else
+#define AYS_STAT_ADD(counter, n) ((void)0)
+#define AYS_STAT_TIMER(stage)
+#define AYS_STAT_CLOCK(var)
+#define AYS_STAT_LATENCY(start) ((void)0)
+#endif
+
+/*
+ * Clock of the expiry and live filters. Scans and engines read the time through an AYS_clock, NULL is the process
+ * default which follows the wall clock until AYS_clock_set fixes it. A replay sets the recorded time of every batch
+ * so the filters decide as they did when the feed was recorded, whatever the replay speed.
+ */
+struct AYS_clock {
+    std::atomic<bool> manual;
+    std::atomic<int64_t> time; // seconds since the epoch when manual
+    AYS_clock() : manual(false), time(0) { }
+};
+
+AYS_clock &AYS_default_clock(){
+    static AYS_clock clock;
+    return clock;
+}
+
+time_t AYS_now(const AYS_clock *clock = NULL){
+    const AYS_clock &c = clock ? *clock : AYS_default_clock();
+    if (c.manual.load(std::memory_order_acquire)){
+        return c.time.load(std::memory_order_relaxed);
+    }
+    return std::time(0);
+}
+
+void AYS_clock_set(AYS_clock &clock, time_t t){
+    clock.time.store(t, std::memory_order_relaxed);
+    clock.manual.store(true, std::memory_order_release);
+}
+
+// back to the wall clock
+void AYS_clock_reset(AYS_clock &clock){
+    clock.manual.store(false, std::memory_order_release);
+}
+
 struct AYS_fixture {
     time_t start_time;
     time_t expiry_time;
@@ -72,280 +324,2125 @@ struct AYS_fixture {
         , participant_odds(std::move(participant_odds)) { }
 };
 
-struct AYS_event {
-    time_t start_time;
-    AYS_sport_id sid;
-    AYS_bet_type_id btid;
-    int line;
-    float arb;
-    float not_arb;
-    float roi;
-    uint32_t arb_flags;
-    std::vector<AYS_participant> participant_names;
-    std::vector<float> participant_stakes;
-    std::vector<AYS_fixture> fixtures;
-    int max_not_arb_idx;
-    AYS_event(std::vector<AYS_fixture> &fixtures) 
-        : start_time(fixtures[0].start_time)
-        , sid(fixtures[0].sid)
-        , btid(fixtures[0].btid)
-        , line(fixtures[0].line)
-        , participant_names(fixtures[0].participant_names)
-        , fixtures(std::move(fixtures)) {
-        arb = std::numeric_limits<float>::infinity();
-        not_arb = std::numeric_limits<float>::infinity();
-        roi = -1;
-        participant_stakes = std::vector<float>(participant_names.size(), 0);
+/*
+ * Feed recording.
+ * A feed log is a sequence of records [uint8 type][varint length][payload]. A session record (magic, version)
+ * starts every AYS_recorder_open and resets the string dictionary, a batch record holds the clock of the batch,
+ * the wall time it was recorded at and its fixtures. Times are zigzag varints relative to the batch clock, ids
+ * varints, odds raw floats (same byte order as the replaying machine), names and currencies are references into the
+ * dictionary, a new string is written once as length and bytes. Records are built in memory and written with one
+ * fwrite so a crash leaves at most one truncated record at the end, which the reader stops at. The strings new to
+ * a record only join the dictionary once it is written, and a failed write closes the recorder so nothing follows
+ * a truncated record.
+ */
+#define AYS_FEED_VERSION 1
+#define AYS_FEED_SESSION 1
+#define AYS_FEED_BATCH 2
+
+struct AYS_feed_recorder {
+    FILE *file;
+    std::unordered_map<std::string, uint32_t> dictionary;
+    std::unordered_map<std::string, uint32_t> staged; // strings new to the record being built
+    std::string payload;
+    std::string record;
+    std::mutex mutex;
+    uint64_t batches;
+    AYS_feed_recorder() : file(NULL), batches(0) { }
+    ~AYS_feed_recorder(){
+        if (file) fclose(file);
     }
 };
 
+void AYS_feed_put_varint(std::string &out, uint64_t v){
+    while (v >= 0x80){
+        out += (char)(v | 0x80);
+        v >>= 7;
+    }
+    out += (char)v;
+}
 
-bool AYS_event_arb(AYS_event &event){
-    std::vector<float> max_odds(event.participant_names.size(),1);
-    std::vector<float> max_not_odds(event.participant_names.size(),1);
-    for (int i = 0; i < (int)event.fixtures.size(); i++){
-        if (max_odds.size() != event.fixtures[i].participant_odds.size()){
-            std::cerr << "diffent amount of outcomes in fixtures 0 and " << i << "\n" 
-                      << AYS_event_to_string(event) << std::endl;
-            return false;
-        }
-        for (int j = 0; j < (int)max_odds.size();j++){
-            if (max_odds[j] > event.fixtures[i].participant_odds[j]){
-                max_odds[j] = event.fixtures[i].participant_odds[j]; 
-            }
-            if (max_not_odds[j] > event.fixtures[i].participant_not_odds[j]){
-                max_not_odds[j] = event.fixtures[i].participant_not_odds[j]; 
-            }
-        }
+void AYS_feed_put_zigzag(std::string &out, int64_t v){
+    AYS_feed_put_varint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+void AYS_feed_put_float(std::string &out, float v){
+    out.append((const char *)&v, sizeof(v));
+}
+
+void AYS_feed_put_string(AYS_feed_recorder &rec, const std::string &value){
+    auto it = rec.dictionary.find(value);
+    if (it != rec.dictionary.end()){
+        AYS_feed_put_varint(rec.payload, it->second);
+        return;
     }
-    float per = 0;
-    for (int i = 0; i < (int)max_odds.size(); i++){
-        per += max_odds[i];
-        if (event.not_arb > max_odds[i]+max_not_odds[i]){
-            event.not_arb = max_odds[i]+max_not_odds[i];
-            event.max_not_arb_idx = i;
-        }
+    it = rec.staged.find(value);
+    if (it != rec.staged.end()){
+        AYS_feed_put_varint(rec.payload, it->second);
+        return;
+    }
+    uint32_t k = rec.dictionary.size() + rec.staged.size();
+    rec.staged.emplace(value, k);
+    AYS_feed_put_varint(rec.payload, k);
+    AYS_feed_put_varint(rec.payload, value.size());
+    rec.payload += value;
+}
 
+// writes the payload as a record of type and commits its new strings, closes the file if that fails
+bool AYS_feed_put_record(AYS_feed_recorder &rec, uint8_t type){
+    rec.record.clear();
+    rec.record += (char)type;
+    AYS_feed_put_varint(rec.record, rec.payload.size());
+    rec.record += rec.payload;
+    bool ok = fwrite(rec.record.data(), 1, rec.record.size(), rec.file) == rec.record.size();
+    if (fflush(rec.file) != 0 || !ok){
+        rec.staged.clear();
+        fclose(rec.file);
+        rec.file = NULL;
+        return false;
     }
-    event.arb = per;
-    event.roi = 100/std::min(per, event.not_arb)-100;
+    rec.dictionary.insert(rec.staged.begin(), rec.staged.end());
+    rec.staged.clear();
     return true;
 }
 
-bool AYS_event_max_arb_stakes(const AYS_event &event, std::vector<float> &stakes, std::vector<int> &max_idx, std::vector<int> &max_not_idx, float *max_profit){
-    max_idx.resize(event.participant_names.size(),-1);
-    max_not_idx.resize(event.participant_names.size(),-1);
-    std::vector<float> max_odds(event.participant_names.size(),1);
-    std::vector<float> max_not_odds(event.participant_names.size(),1);
-    for (int i = 0; i < (int)event.fixtures.size(); i++){
-        for (int j = 0; j < (int)max_odds.size();j++){
-            if (max_odds[j] > event.fixtures[i].participant_odds[j]){
-                max_odds[j] = event.fixtures[i].participant_odds[j]; 
-                max_idx[j] = i; 
-            }
-            if (max_not_odds[j] > event.fixtures[i].participant_not_odds[j]){
-                max_not_odds[j] = event.fixtures[i].participant_not_odds[j]; 
-                max_not_idx[j] = i; 
-            }
-        }
+// starts a new session in the file just opened, closes it if that fails
+bool AYS_recorder_start(AYS_feed_recorder &rec, const std::string &name){
+    if (!rec.file){
+        std::cerr << "could not open " << name << std::endl;
+        return false;
     }
-    float max_total_stake = std::numeric_limits<float>::infinity();
-    float total_percentage_odds = std::min(event.not_arb,event.arb);
-    if (event.arb <= event.not_arb){
-        stakes.resize(event.participant_names.size(),0);
-        for (int idx = 0; idx < (int)event.participant_names.size(); idx++){
-            float potential_stake = event.fixtures[max_idx[idx]].max_nominal_bet*total_percentage_odds/max_odds[idx];
-            if (max_total_stake > potential_stake) {
-                max_total_stake = potential_stake;
-            }
-        }
-        for (int idx = 0; idx < (int)event.participant_names.size(); idx++){
-            stakes[idx] = max_total_stake*max_odds[idx]/total_percentage_odds;
-        }
-    } else {
-        stakes.resize(2,0);
-        int idx = event.max_not_arb_idx;
-        max_total_stake = std::min(event.fixtures[max_idx[idx]].max_nominal_bet*total_percentage_odds/max_odds[idx],
-                                   event.fixtures[max_not_idx[idx]].max_nominal_bet*total_percentage_odds/max_not_odds[idx]);
-        stakes[0] = max_total_stake*max_odds[idx]/total_percentage_odds;
-        stakes[1] = max_total_stake*max_not_odds[idx]/total_percentage_odds;
+    rec.dictionary.clear();
+    rec.staged.clear();
+    rec.payload.assign("AYSFEED", 8);
+    AYS_feed_put_varint(rec.payload, AYS_FEED_VERSION);
+    if (!AYS_feed_put_record(rec, AYS_FEED_SESSION)){
+        std::cerr << "could not write " << name << std::endl;
+        return false;
     }
-    *max_profit = max_total_stake/total_percentage_odds-max_total_stake;
     return true;
 }
 
+// appends to the log at path, starting a new session
+bool AYS_recorder_open(AYS_feed_recorder &rec, const std::string &path){
+    std::lock_guard<std::mutex> lock(rec.mutex);
+    if (rec.file) fclose(rec.file);
+    rec.file = fopen(path.c_str(), "ab");
+    return AYS_recorder_start(rec, path);
+}
 
-std::string AYS_event_to_string_pretty(const AYS_event &event, std::vector<std::string> provider_names) {
-    std::vector<float> max_odds(event.participant_names.size(),1);
-    std::vector<float> max_not_odds(event.participant_names.size(),1);
-    for (int i = 0; i < (int)event.fixtures.size(); i++){
-        for (int j = 0; j < (int)max_odds.size();j++){
-            if (max_odds[j] > event.fixtures[i].participant_odds[j]){
-                max_odds[j] = event.fixtures[i].participant_odds[j]; 
-            }
-            if (max_not_odds[j] > event.fixtures[i].participant_not_odds[j]){
-                max_not_odds[j] = event.fixtures[i].participant_not_odds[j]; 
-            }
-        }
-    }
-    bool not_odds = event.not_arb < event.arb;
-    std::tm * ptm = std::localtime(&event.start_time);
-    char buffer[32];
-    std::strftime(buffer, 32, "%d/%m-%YT%H:%M:%S", ptm);
-    std::vector<float> stakes; 
-    std::vector<int> max_idx; 
-    std::vector<int> max_not_idx; 
-    float max_profit = 0;
-    if (!AYS_event_max_arb_stakes(event, stakes, max_idx, max_not_idx, &max_profit)){
-        return "STAKES FAIL";
-    }
-    std::string result = fmt::format("@ {} sid: {} btid: {}{} {}ARB: {:.2f}% ROI: {:.2f}% profit: {:.2f} assuming same currency\n\t", buffer, event.sid, event.btid, 
-                          (event.line?fmt::format(" line: {}",event.line):""),
-                          event.arb <= event.not_arb?"":"n", 
-                          std::min(event.arb,event.not_arb)*100,
-                          event.roi,
-                          max_profit);
+#ifndef _WIN32
+// streams the log to fd, eg. a socket, the recorder owns fd from now on
+bool AYS_recorder_fdopen(AYS_feed_recorder &rec, int fd){
+    std::lock_guard<std::mutex> lock(rec.mutex);
+    if (rec.file) fclose(rec.file);
+    rec.file = fdopen(fd, "wb");
+    if (!rec.file) close(fd);
+    return AYS_recorder_start(rec, fmt::format("fd {}", fd));
+}
+#endif
 
-    int min_width = 5;
-    if (not_odds){
-        int width = std::max(min_width,(int)event.fixtures[0].participant_names[event.max_not_arb_idx].size());
-        int not_width = std::max(min_width,(int)event.fixtures[0].participant_names[event.max_not_arb_idx].size()+4);
-        result += fmt::format("{0:^{1}.2f} | {2:^{3}.2f}", stakes[0], width, stakes[1], not_width); 
-        result += " <- stakes for max profit\n"; 
-        result += fmt::format("\t{0:^{1}} | Not {0:^{1}}", event.participant_names[event.max_not_arb_idx], min_width);
-    } else {
-        for (int i = 0; i < (int) stakes.size(); i++ ){
-            int width = std::max(min_width,(int)event.fixtures[0].participant_names[i].size());
-            result += fmt::format("{:^{}.2f} | ", stakes[i], width); 
-        }
-        result += " <- stakes for max profit\n"; 
-        result += fmt::format("\t{:^{}}", event.participant_names[0], min_width);
-        for (int i = 1; i< (int)event.participant_names.size(); i++){
-            result += fmt::format(" | {:^{}}", event.participant_names[i], min_width);
+void AYS_recorder_close(AYS_feed_recorder &rec){
+    std::lock_guard<std::mutex> lock(rec.mutex);
+    if (rec.file) fclose(rec.file);
+    rec.file = NULL;
+}
+
+// records a batch of the count fixtures fixture(i) as seen at now
+template<typename F>
+bool AYS_recorder_append_with(AYS_feed_recorder &rec, size_t count, time_t now, F fixture){
+    std::lock_guard<std::mutex> lock(rec.mutex);
+    if (!rec.file) return false;
+    int64_t wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    rec.payload.clear();
+    AYS_feed_put_zigzag(rec.payload, now);
+    AYS_feed_put_varint(rec.payload, wall_ns);
+    AYS_feed_put_varint(rec.payload, count);
+    for (size_t i = 0; i < count; i++){
+        const AYS_fixture &f = fixture(i);
+        AYS_feed_put_zigzag(rec.payload, (int64_t)f.start_time - now);
+        AYS_feed_put_zigzag(rec.payload, (int64_t)f.expiry_time - now);
+        AYS_feed_put_varint(rec.payload, f.pid);
+        AYS_feed_put_varint(rec.payload, f.id);
+        AYS_feed_put_varint(rec.payload, f.sid);
+        AYS_feed_put_varint(rec.payload, f.btid);
+        AYS_feed_put_zigzag(rec.payload, f.line);
+        AYS_feed_put_float(rec.payload, f.max_nominal_bet);
+        AYS_feed_put_string(rec, f.currency);
+        AYS_feed_put_varint(rec.payload, f.participant_names.size());
+        for (size_t j = 0; j < f.participant_names.size(); j++){
+            AYS_feed_put_string(rec, f.participant_names[j]);
+            AYS_feed_put_float(rec.payload, f.participant_not_odds[j]);
+            AYS_feed_put_float(rec.payload, f.participant_odds[j]);
         }
     }
-    result += " | max bet | currency | provider | event id \n";
-    for (int i = 0; i < (int)event.fixtures.size(); i++){
-        bool is_maximal = false;
-        if (not_odds){
-            is_maximal = event.fixtures[i].participant_not_odds[event.max_not_arb_idx] == max_not_odds[event.max_not_arb_idx]
-                       | event.fixtures[i].participant_odds[event.max_not_arb_idx] == max_odds[event.max_not_arb_idx];
-        } else {
-            for (int idx = 0; idx < (int)event.fixtures[i].participant_odds.size(); idx++){
-                is_maximal |= event.fixtures[i].participant_odds[idx] == max_odds[idx];
-            } 
-        }
-        if (!is_maximal) continue;
-        result += "\t";
-        std::string s = " ";
-        if (not_odds){
-            int width = std::max(min_width,(int)event.fixtures[0].participant_names[event.max_not_arb_idx].size());
-            s = " ";
-            if (event.fixtures[i].participant_odds[event.max_not_arb_idx] < 1.){
-                s = fmt::format("{:.2f}", 1/event.fixtures[i].participant_odds[event.max_not_arb_idx]); 
-            }
-            result += fmt::format("{:^{}}", s, width); 
-            width = std::max(min_width,(int)event.fixtures[0].participant_names[event.max_not_arb_idx].size()+4);
-            s = " ";
-            if (event.fixtures[i].participant_not_odds[event.max_not_arb_idx] < 1.){
-                s = fmt::format("{:.2f}", 1/event.fixtures[i].participant_not_odds[event.max_not_arb_idx]); 
-            }
-            result += fmt::format(" | {:^{}}", s, width); 
-        } else {
-            int width = std::max(min_width,(int)event.fixtures[0].participant_names[0].size());
-            if (event.fixtures[i].participant_odds[0] < 1.){
-                s = fmt::format("{:.2f}", 1/event.fixtures[i].participant_odds[0]); 
-            }
-            result += fmt::format("{:^{}}", s, width); 
-            for (int j = 1; j < (int)event.fixtures[i].participant_odds.size(); j++){
-                int width = std::max(min_width,(int)event.fixtures[0].participant_names[j].size());
-                s = " ";
-                if (event.fixtures[i].participant_odds[j] < 1.){
-                    s = fmt::format("{:.2f}", 1/event.fixtures[i].participant_odds[j]); 
-                }
-                result += fmt::format(" | {:^{}}", s, width); 
-            }
-        }
-        result += fmt::format(" | {:^7.2f} | {:^8} | {:^8} | {}\n",event.fixtures[i].max_nominal_bet,event.fixtures[i].currency, provider_names[event.fixtures[i].pid], event.fixtures[i].id); 
+    if (!AYS_feed_put_record(rec, AYS_FEED_BATCH)){
+        std::cerr << "could not record batch " << rec.batches << ", recorder closed" << std::endl;
+        return false;
     }
-    return result;
+    rec.batches++;
+    return true;
 }
 
-std::string AYS_fixture_to_string(const AYS_fixture fixture) {
-    bool print_not_odds = false;
-    for (int i = 0; i< (int)fixture.participant_not_odds.size(); i++){
-        print_not_odds |= fixture.participant_not_odds[i] > 1.;
-    }
-    std::string result = fixture.participant_names[0];
-    for (int i = 1; i< (int)fixture.participant_names.size(); i++){
-        result += " | " + fixture.participant_names[i];
-    }
-    for (int i = 0; print_not_odds && i < (int)fixture.participant_names.size(); i++){
-        result += " | NOT "  + fixture.participant_names[i];
+// records a batch of fixtures as seen at now
+bool AYS_recorder_append(AYS_feed_recorder &rec, const std::vector<AYS_fixture> &fs, time_t now){
+    return AYS_recorder_append_with(rec, fs.size(), now, [&fs](size_t i) -> const AYS_fixture & { return fs[i]; });
+}
+
+struct AYS_feed_batch {
+    time_t clock; // AYS_now() of the recorded scan
+    int64_t wall_ns; // system clock when it was recorded, the pace of a replay
+    std::vector<AYS_fixture> fixtures;
+};
+
+struct AYS_feed_reader {
+    FILE *file;
+    std::vector<std::string> dictionary;
+    std::string payload;
+    const char *cursor;
+    const char *end;
+    AYS_feed_reader() : file(NULL), cursor(NULL), end(NULL) { }
+    ~AYS_feed_reader(){
+        if (file) fclose(file);
     }
-    std::tm * ptm = std::localtime(&fixture.start_time);
-    char buffer[32];
-    std::strftime(buffer, 32, "%d/%m-%YT%H:%M:%S", ptm);
-    result += " @ " + std::string(buffer) + " sid: " + std::to_string(fixture.sid) + " line: " + std::to_string(fixture.line)  + " pid "+ std::to_string(fixture.pid) + " ";
-    result += std::to_string(fixture.participant_odds[0]);
-    for (int i = 1; i< (int)fixture.participant_odds.size(); i++){
-        result += " | " + std::to_string(fixture.participant_odds[i]);
+};
+
+bool AYS_reader_open(AYS_feed_reader &reader, const std::string &path){
+    if (reader.file) fclose(reader.file);
+    reader.dictionary.clear();
+    reader.file = fopen(path.c_str(), "rb");
+    if (!reader.file){
+        std::cerr << "could not open " << path << std::endl;
+        return false;
     }
-    for (int i = 0; print_not_odds && i < (int)fixture.participant_not_odds.size(); i++){
-        result += " | " + std::to_string(fixture.participant_not_odds[i]);
+    return true;
+}
+
+#ifndef _WIN32
+bool AYS_unix_address(const std::string &path, struct sockaddr_un &address){
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)){
+        std::cerr << "socket path too long " << path << std::endl;
+        return false;
     }
-    return result;
+    memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
 }
-std::string AYS_event_to_string(const AYS_event event) {
-    std::string result = event.participant_names[0];
-    for (int i = 1; i< (int)event.participant_names.size(); i++){
-        result += " | " + event.participant_names[i];
+
+// a stream socket connected to the unix socket at path, -1 if it fails
+int AYS_unix_connect(const std::string &path){
+    struct sockaddr_un address;
+    if (!AYS_unix_address(path, address)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0){
+        std::cerr << "could not connect to " << path << std::endl;
+        if (fd >= 0) close(fd);
+        return -1;
     }
-    std::tm * ptm = std::localtime(&event.start_time);
-    char buffer[32];
-    std::strftime(buffer, 32, "%d/%m-%YT%H:%M:%S", ptm);
-    result += " @ " + std::string(buffer)+ " sid: " + std::to_string(event.sid) + " btid: " + std::to_string(event.btid) + " line: " + std::to_string(event.line) + " ARB(not): " + std::to_string(event.arb*100) + "% (" +std::to_string(event.not_arb*100) + "%)" + " ROI: " + std::to_string(event.roi) + "%";
-    time_t now = std::time(0);
-    for (int i = 0; i< (int)event.fixtures.size(); i++){
-        if (difftime(event.fixtures[i].expiry_time, now) > 0){
-            result += "\n    " + AYS_fixture_to_string(event.fixtures[i]);
-        }
+    return fd;
+}
+
+// a unix socket listening at path, a stale socket file at path is replaced. -1 if it fails
+int AYS_unix_listen(const std::string &path, int backlog = 16){
+    struct sockaddr_un address;
+    if (!AYS_unix_address(path, address)) return -1;
+    unlink(path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, backlog) != 0){
+        std::cerr << "could not listen at " << path << std::endl;
+        if (fd >= 0) close(fd);
+        return -1;
     }
-    return result;
+    return fd;
+}
 
+// reads a log streamed to fd, the reader owns fd from now on
+bool AYS_reader_fdopen(AYS_feed_reader &reader, int fd){
+    if (reader.file) fclose(reader.file);
+    reader.dictionary.clear();
+    reader.file = fdopen(fd, "rb");
+    if (!reader.file){
+        std::cerr << "could not read fd " << fd << std::endl;
+        close(fd);
+        return false;
+    }
+    return true;
 }
-bool AYS_roi_compare(const AYS_event &e1, const AYS_event &e2){
-    return e1.roi < e2.roi;
+
+// reads a log streamed over the unix socket at path, eg. by a provider adapter writing AYS_feed_recorder records
+bool AYS_reader_connect(AYS_feed_reader &reader, const std::string &path){
+    if (reader.file) fclose(reader.file);
+    reader.file = NULL;
+    int fd = AYS_unix_connect(path);
+    return fd >= 0 && AYS_reader_fdopen(reader, fd);
 }
-bool AYS_arb_compare(const AYS_event &e1, const AYS_event &e2){
-    return std::min(e1.arb,e1.not_arb) > std::min(e2.arb,e2.not_arb);
+#endif
+
+bool AYS_feed_get_varint(AYS_feed_reader &reader, uint64_t &v){
+    v = 0;
+    for (int shift = 0; shift < 64 && reader.cursor < reader.end; shift += 7){
+        uint8_t b = *reader.cursor++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
 }
-bool AYS_line_compare(const AYS_fixture &f1, const AYS_fixture &f2){
-    return f1.line < f2.line;
+
+bool AYS_feed_get_zigzag(AYS_feed_reader &reader, int64_t &v){
+    uint64_t u;
+    if (!AYS_feed_get_varint(reader, u)) return false;
+    v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+    return true;
 }
-bool AYS_start_time_compare(const AYS_fixture &f1, const AYS_fixture &f2){
-    return difftime(f1.start_time, f2.start_time) < 0;
+
+bool AYS_feed_get_float(AYS_feed_reader &reader, float &v){
+    if (reader.end - reader.cursor < (ptrdiff_t)sizeof(v)) return false;
+    memcpy(&v, reader.cursor, sizeof(v));
+    reader.cursor += sizeof(v);
+    return true;
 }
-bool AYS_participant_number_compare(const AYS_fixture &f1, const AYS_fixture &f2){
-    return f1.participant_names.size() < f2.participant_names.size();
+
+bool AYS_feed_get_string(AYS_feed_reader &reader, std::string &value){
+    uint64_t k, size;
+    if (!AYS_feed_get_varint(reader, k) || k > reader.dictionary.size()) return false;
+    if (k < reader.dictionary.size()){
+        value = reader.dictionary[k];
+        return true;
+    }
+    if (!AYS_feed_get_varint(reader, size) || (uint64_t)(reader.end - reader.cursor) < size) return false;
+    value.assign(reader.cursor, size);
+    reader.cursor += size;
+    reader.dictionary.push_back(value);
+    return true;
 }
 
-bool AYS_btid_compare(const AYS_fixture &f1, const AYS_fixture &f2){
-    return f1.btid < f2.btid;
+bool AYS_feed_get_batch(AYS_feed_reader &reader, AYS_feed_batch &batch){
+    int64_t clock, start, expiry, line;
+    uint64_t wall_ns, count, pid, id, sid, btid, participants;
+    float max_bet;
+    std::string currency;
+    if (!AYS_feed_get_zigzag(reader, clock) || !AYS_feed_get_varint(reader, wall_ns) || !AYS_feed_get_varint(reader, count)) return false;
+    batch.clock = clock;
+    batch.wall_ns = wall_ns;
+    batch.fixtures.clear();
+    batch.fixtures.reserve(std::min<uint64_t>(count, reader.end - reader.cursor));
+    for (uint64_t i = 0; i < count; i++){
+        if (!AYS_feed_get_zigzag(reader, start) || !AYS_feed_get_zigzag(reader, expiry) || !AYS_feed_get_varint(reader, pid) 
+            || !AYS_feed_get_varint(reader, id) || !AYS_feed_get_varint(reader, sid) || !AYS_feed_get_varint(reader, btid) 
+            || !AYS_feed_get_zigzag(reader, line) || !AYS_feed_get_float(reader, max_bet) || !AYS_feed_get_string(reader, currency) 
+            || !AYS_feed_get_varint(reader, participants) || participants > (uint64_t)(reader.end - reader.cursor)) return false;
+        std::vector<AYS_participant> names(participants);
+        std::vector<AYS_odd> not_odds(participants);
+        std::vector<AYS_odd> odds(participants);
+        for (uint64_t j = 0; j < participants; j++){
+            if (!AYS_feed_get_string(reader, names[j]) || !AYS_feed_get_float(reader, not_odds[j]) || !AYS_feed_get_float(reader, odds[j])) return false;
+        }
+        batch.fixtures.emplace_back(clock+start, clock+expiry, pid, id, sid, btid, line, currency, max_bet, names, not_odds, odds);
+    }
+    return reader.cursor == reader.end;
 }
 
-bool AYS_sid_compare(const AYS_fixture &f1, const AYS_fixture &f2){
-    return f1.sid < f2.sid;
+// reads the next batch, false at the end of the log or at the first record that cannot be read
+bool AYS_feed_next(AYS_feed_reader &reader, AYS_feed_batch &batch){
+    while (reader.file){
+        int type = fgetc(reader.file);
+        if (type == EOF) return false;
+        uint64_t size = 0;
+        int shift = 0, b;
+        do {
+            b = fgetc(reader.file);
+            if (b == EOF || shift >= 64){
+                std::cerr << "truncated feed record" << std::endl;
+                return false;
+            }
+            size |= (uint64_t)(b & 0x7f) << shift;
+            shift += 7;
+        } while (b & 0x80);
+        reader.payload.resize(size);
+        if (fread(&reader.payload[0], 1, size, reader.file) != size){
+            std::cerr << "truncated feed record" << std::endl;
+            return false;
+        }
+        reader.cursor = reader.payload.data();
+        reader.end = reader.cursor + size;
+        if (type == AYS_FEED_SESSION){
+            uint64_t version;
+            bool magic = size >= 8 && memcmp(reader.payload.data(), "AYSFEED", 8) == 0;
+            reader.cursor += magic ? 8 : 0;
+            if (!magic || !AYS_feed_get_varint(reader, version) || version != AYS_FEED_VERSION){
+                std::cerr << "not a version " << AYS_FEED_VERSION << " feed log" << std::endl;
+                return false;
+            }
+            reader.dictionary.clear();
+        } else if (type == AYS_FEED_BATCH){
+            if (!AYS_feed_get_batch(reader, batch)){
+                std::cerr << "corrupt feed batch" << std::endl;
+                return false;
+            }
+            return true;
+        } // records of other types are skipped
+    }
+    return false;
 }
 
-int min_weight_matching(const int pairs, const std::vector<std::vector<int>> &weightMatrix, std::vector<int> &solution){
-    using Graph = lemon::SmartDigraph;
-    using Node = Graph::Node;
-    using Arc = Graph::Arc;
-    using MCF = lemon::NetworkSimplex<Graph, int32_t, int32_t>;
+/*
+ * Scan arena.
+ * A bump allocator for the temporaries of a scan: allocations advance a cursor in the current block, nothing is
+ * freed on its own and AYS_arena_reset rewinds the cursor. A scan that outgrows the block spills into new blocks,
+ * the next reset folds them into a single block of the peak size, so once the arena has seen a book of the size a
+ * scan allocates nothing from the heap and a reset is O(1). AYS_arena_allocator puts the standard containers on an
+ * arena, without one (NULL) they use the heap like std::allocator.
+ */
+#define AYS_ARENA_MIN_BLOCK (64 << 10)
 
-    int nodeNum = pairs*2+2; // worker and task in each pair + source and sink
-    int arcNum = pairs*(pairs+2); // all to all between workers and tasks 
+struct AYS_arena {
+    std::unique_ptr<char[]> block;
+    size_t size; // of block
+    size_t used; // of block
+    std::vector<std::unique_ptr<char[]>> spilled; // full blocks since the last reset
+    size_t spilled_used; // bytes handed out from the spilled blocks
+    size_t peak; // most bytes handed out between two resets
+    uint64_t allocations; // since the last reset
+    uint64_t heap_blocks; // blocks taken from the heap, since creation
+    AYS_arena() 
+        : size(0)
+        , used(0)
+        , spilled_used(0)
+        , peak(0)
+        , allocations(0)
+        , heap_blocks(0) { }
+};
+
+size_t AYS_arena_used(const AYS_arena &arena){
+    return arena.spilled_used + arena.used;
+}
+
+// align is a power of two up to alignof(std::max_align_t)
+void *AYS_arena_alloc(AYS_arena &arena, size_t bytes, size_t align){
+    arena.allocations++;
+    size_t start = (arena.used + align-1) & ~(align-1);
+    if (!arena.block || start + bytes > arena.size){
+        if (arena.block){
+            arena.spilled_used += arena.used;
+            arena.spilled.push_back(std::move(arena.block));
+        }
+        arena.size = std::max(std::max<size_t>(AYS_ARENA_MIN_BLOCK, 2*arena.size), bytes);
+        arena.block.reset(new char[arena.size]);
+        arena.heap_blocks++;
+        start = 0;
+    }
+    arena.used = start + bytes;
+    arena.peak = std::max(arena.peak, AYS_arena_used(arena));
+    return arena.block.get() + start;
+}
+
+void AYS_arena_reset(AYS_arena &arena){
+    if (arena.spilled.size() > 0){
+        // a little slack for the alignment padding, which depends on where the blocks start
+        arena.size = arena.peak + arena.peak/8;
+        arena.spilled.clear();
+        arena.block.reset(new char[arena.size]);
+        arena.heap_blocks++;
+    }
+    arena.used = 0;
+    arena.spilled_used = 0;
+    arena.allocations = 0;
+}
+
+template<typename T>
+struct AYS_arena_allocator {
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+    AYS_arena *arena; // NULL allocates from the heap
+    AYS_arena_allocator(AYS_arena *arena = NULL) : arena(arena) { }
+    template<typename U>
+    AYS_arena_allocator(const AYS_arena_allocator<U> &other) : arena(other.arena) { }
+    T *allocate(size_t n){
+        if (!arena){
+            return static_cast<T*>(::operator new(n*sizeof(T)));
+        }
+        return static_cast<T*>(AYS_arena_alloc(*arena, n*sizeof(T), alignof(T)));
+    }
+    void deallocate(T *p, size_t){
+        if (!arena){
+            ::operator delete(p);
+        }
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const AYS_arena_allocator<T> &a1, const AYS_arena_allocator<U> &a2){
+    return a1.arena == a2.arena;
+}
+
+template<typename T, typename U>
+bool operator!=(const AYS_arena_allocator<T> &a1, const AYS_arena_allocator<U> &a2){
+    return a1.arena != a2.arena;
+}
+
+template<typename T>
+using AYS_arena_vector = std::vector<T, AYS_arena_allocator<T>>;
+
+// the arenas of a scan, the sequential stages allocate from arenas[0] and worker w of the parallel ones from arenas[1+w]
+struct AYS_scan_arena {
+    std::vector<AYS_arena> arenas;
+};
+
+void AYS_scan_arena_reset(AYS_scan_arena &scan, int threads){
+    scan.arenas.resize(1 + std::max(1, threads));
+    for (auto& arena : scan.arenas){
+        AYS_arena_reset(arena);
+    }
+}
+
+// the arena of a worker, -1 for the sequential stages, NULL (the heap) without a scan arena
+AYS_arena *AYS_scan_arena_get(AYS_scan_arena *scan, int worker){
+    return scan ? &scan->arenas[1+worker] : NULL;
+}
+
+// the most memory the scans took at once, summed over the arenas
+size_t AYS_scan_arena_peak(const AYS_scan_arena &scan){
+    size_t peak = 0;
+    for (auto& arena : scan.arenas){
+        peak += arena.peak;
+    }
+    return peak;
+}
+
+std::string AYS_scan_arena_stats(const AYS_scan_arena &scan){
+    size_t used = 0;
+    uint64_t allocations = 0, heap_blocks = 0;
+    for (auto& arena : scan.arenas){
+        used += AYS_arena_used(arena);
+        allocations += arena.allocations;
+        heap_blocks += arena.heap_blocks;
+    }
+    return fmt::format("scan arena used: {} peak: {} bytes allocations: {} heap blocks: {}", 
+                       used, AYS_scan_arena_peak(scan), allocations, heap_blocks);
+}
+
+/*
+ * Interned strings.
+ * Participant names and currencies are kept once per process and referred to by 32 bit ids, the store, the
+ * events, the matching and the caches only handle ids. A name is folded (AYS_fold_name), hashed and split into
+ * bigrams (AYS_name_bigrams) the first time it is seen. Entries are never moved or removed, they live in fixed
+ * size chunks so readers index them without a lock while another thread interns, only interning takes the mutex.
+ */
+typedef uint32_t AYS_name_id;
+typedef uint32_t AYS_currency_id;
+
+#define AYS_INTERN_CHUNK_BITS 12
+#define AYS_INTERN_CHUNKS 4096 // 16M strings per table
+
+struct AYS_interned {
+    std::string str;
+    std::string folded;
+    std::vector<uint32_t> bigrams; // of folded, sorted and unique
+    uint64_t hash; // of folded
+};
+
+struct AYS_intern_table {
+    std::mutex lock;
+    std::unordered_map<std::string, uint32_t> ids;
+    std::atomic<AYS_interned*> chunks[AYS_INTERN_CHUNKS];
+    uint32_t size;
+    AYS_intern_table() : size(0) {
+        for (auto& chunk : chunks){
+            chunk.store(NULL, std::memory_order_relaxed);
+        }
+    }
+    ~AYS_intern_table(){
+        for (auto& chunk : chunks){
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+};
+
+/*
+ * Names are compared in a folded form, ASCII lower case with the Latin-1 letters (UTF-8) mapped to their base
+ * letters, so "Køge BK" and "KOGE BK" are the same name.
+ */
+std::string AYS_fold_name(const AYS_participant &name){
+    static const char *latin1[64] = { // U+00C0 - U+00FF
+        "a","a","a","a","a","a","ae","c","e","e","e","e","i","i","i","i",
+        "d","n","o","o","o","o","o","\xc3\x97","o","u","u","u","u","y","th","ss",
+        "a","a","a","a","a","a","ae","c","e","e","e","e","i","i","i","i",
+        "d","n","o","o","o","o","o","\xc3\xb7","o","u","u","u","u","y","th","y"};
+    std::string folded;
+    folded.reserve(name.size());
+    for (size_t i = 0; i < name.size(); i++){
+        unsigned char c = name[i];
+        if (c == 0xc3 && i+1 < name.size() && ((unsigned char)name[i+1] & 0xc0) == 0x80){
+            folded += latin1[(unsigned char)name[i+1] & 0x3f];
+            i++;
+        } else {
+            folded += (char)std::tolower(c);
+        }
+    }
+    return folded;
+}
+
+// the distinct byte bigrams of a name padded with a start and an end marker, lower cased, sorted
+void AYS_name_bigrams(const AYS_participant &name, std::vector<uint32_t> &out){
+    out.clear();
+    uint32_t prev = 256; // start marker
+    for (unsigned char c : name){
+        uint32_t cur = std::tolower(c);
+        out.push_back(prev*257 + cur);
+        prev = cur;
+    }
+    out.push_back(prev*257 + 256); // end marker
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+AYS_intern_table &AYS_names(){
+    static AYS_intern_table names;
+    return names;
+}
+
+AYS_intern_table &AYS_currencies(){
+    static AYS_intern_table currencies;
+    return currencies;
+}
+
+uint32_t AYS_intern(AYS_intern_table &table, const std::string &str){
+    std::lock_guard<std::mutex> guard(table.lock);
+    auto it = table.ids.find(str);
+    if (it != table.ids.end()){
+        return it->second;
+    }
+    uint32_t id = table.size;
+    if ((id >> AYS_INTERN_CHUNK_BITS) >= AYS_INTERN_CHUNKS){
+        std::cerr << "intern table full" << std::endl;
+        std::abort();
+    }
+    std::atomic<AYS_interned*> &chunk = table.chunks[id >> AYS_INTERN_CHUNK_BITS];
+    if (chunk.load(std::memory_order_relaxed) == NULL){
+        chunk.store(new AYS_interned[1 << AYS_INTERN_CHUNK_BITS], std::memory_order_release);
+    }
+    AYS_interned &entry = chunk.load(std::memory_order_relaxed)[id & ((1 << AYS_INTERN_CHUNK_BITS)-1)];
+    entry.str = str;
+    entry.folded = AYS_fold_name(str);
+    AYS_name_bigrams(entry.folded, entry.bigrams);
+    entry.hash = std::hash<std::string>()(entry.folded);
+    table.ids.emplace(str, id);
+    table.size++;
+    return id;
+}
+
+const AYS_interned &AYS_interned_get(const AYS_intern_table &table, uint32_t id){
+    return table.chunks[id >> AYS_INTERN_CHUNK_BITS].load(std::memory_order_acquire)[id & ((1 << AYS_INTERN_CHUNK_BITS)-1)];
+}
+
+const AYS_interned &AYS_name_entry(AYS_name_id id){
+    return AYS_interned_get(AYS_names(), id);
+}
+
+const AYS_participant &AYS_name(AYS_name_id id){
+    return AYS_name_entry(id).str;
+}
+
+const std::string &AYS_currency(AYS_currency_id id){
+    return AYS_interned_get(AYS_currencies(), id).str;
+}
+
+/*
+ * A store column, owning its values or viewing them in a mapped snapshot (AYS_snapshot_load). Reads go through
+ * one pointer either way, the first write to a viewed column copies it into owned memory.
+ */
+template<typename T>
+struct AYS_column {
+    std::vector<T> owned;
+    const T *values; // owned.data() or the mapped values
+    size_t count;
+    bool mapped;
+    AYS_column() : values(NULL), count(0), mapped(false) { }
+    AYS_column(size_t n, const T &value) : owned(n, value), values(owned.data()), count(n), mapped(false) { }
+    AYS_column(const AYS_column &other) 
+        : owned(other.owned)
+        , values(other.mapped ? other.values : owned.data())
+        , count(other.count)
+        , mapped(other.mapped) { }
+    AYS_column(AYS_column &&other) 
+        : owned(std::move(other.owned))
+        , values(other.mapped ? other.values : owned.data())
+        , count(other.count)
+        , mapped(other.mapped) { }
+    AYS_column &operator=(AYS_column other){
+        owned.swap(other.owned);
+        mapped = other.mapped;
+        count = other.count;
+        values = mapped ? other.values : owned.data();
+        return *this;
+    }
+    size_t size() const {
+        return count;
+    }
+    const T *data() const {
+        return values;
+    }
+    const T &operator[](size_t i) const {
+        return values[i];
+    }
+    T &operator[](size_t i){
+        own();
+        return owned[i];
+    }
+    void own(){
+        if (mapped){
+            owned.assign(values, values+count);
+            mapped = false;
+            values = owned.data();
+        }
+    }
+    void view(const T *mapped_values, size_t n){
+        std::vector<T>().swap(owned);
+        values = mapped_values;
+        count = n;
+        mapped = true;
+    }
+    void push_back(const T &value){
+        own();
+        owned.push_back(value);
+        values = owned.data();
+        count = owned.size();
+    }
+    void reserve(size_t n){
+        own();
+        owned.reserve(n);
+        values = owned.data();
+    }
+    // keeps the owned capacity
+    void clear(){
+        own();
+        owned.clear();
+        values = owned.data();
+        count = 0;
+    }
+};
+
+/*
+ * Stored odds. With -DAYS_QUANTIZED_ODDS the store keeps the inverse odds as 16 bit fixed point with
+ * AYS_ODDS_FRACTION_BITS fraction bits (14 by default, ie. [0, 2) in steps of 2^-14) instead of floats: half the
+ * memory, twice the lanes in the batch arb kernels, and best prices compare exactly. Sums of up to 3 participants
+ * are exact in 32 bits. Without it AYS_odd_q is float and every conversion is the identity. The API (AYS_fixture,
+ * AYS_event::odd, arb, roi) stays float either way.
+ */
+#ifdef AYS_QUANTIZED_ODDS
+#ifndef AYS_ODDS_FRACTION_BITS
+#define AYS_ODDS_FRACTION_BITS 14
+#endif
+static_assert(AYS_ODDS_FRACTION_BITS >= 1 && AYS_ODDS_FRACTION_BITS <= 14, "the inverse odds 1 (no price) must fit in an int16_t");
+typedef int16_t AYS_odd_q;
+typedef int32_t AYS_odd_sum; // sums of AYS_odd_q
+#define AYS_ODDS_ONE ((AYS_odd_q)(1 << AYS_ODDS_FRACTION_BITS))
+#else
+#define AYS_ODDS_FRACTION_BITS 0
+typedef float AYS_odd_q;
+typedef float AYS_odd_sum;
+#define AYS_ODDS_ONE 1.f
+#endif
+
+// rounds up, a quantized book never shows an arb the float prices do not have
+AYS_odd_q AYS_odds_quantize(AYS_odd odd){
+#ifdef AYS_QUANTIZED_ODDS
+    float q = std::ceil(odd*AYS_ODDS_ONE);
+    if (!(q < std::numeric_limits<AYS_odd_q>::max())) return std::numeric_limits<AYS_odd_q>::max(); // and NaN
+    return q > 0 ? (AYS_odd_q)q : 0;
+#else
+    return odd;
+#endif
+}
+
+AYS_odd AYS_odds_float(AYS_odd_sum q){
+#ifdef AYS_QUANTIZED_ODDS
+    return q*(1.f/AYS_ODDS_ONE);
+#else
+    return q;
+#endif
+}
+
+// start of a min reduction over sums
+AYS_odd_sum AYS_odds_sum_max(){
+    return std::numeric_limits<AYS_odd_sum>::has_infinity ? std::numeric_limits<AYS_odd_sum>::infinity() : std::numeric_limits<AYS_odd_sum>::max();
+}
+
+/*
+ * Columnar fixture book, one entry per fixture in each of the fixed width columns and the participants
+ * of fixture i in [offset[i], offset[i+1]) of the flat participant columns.
+ */
+struct AYS_fixture_store {
+    AYS_column<time_t> start_time;
+    AYS_column<time_t> expiry_time;
+    AYS_column<AYS_provider_id> pid;
+    AYS_column<AYS_fixture_id> id;
+    AYS_column<AYS_sport_id> sid;
+    AYS_column<AYS_bet_type_id> btid;
+    AYS_column<int> line;
+    AYS_column<float> max_nominal_bet;
+    AYS_column<AYS_currency_id> currency;
+    AYS_column<uint32_t> offset;
+    AYS_column<AYS_name_id> participant_ids;
+    AYS_column<AYS_odd_q> participant_not_odds; // see AYS_odds_quantize
+    AYS_column<AYS_odd_q> participant_odds;
+    std::shared_ptr<const void> mapping; // keeps the snapshot the viewed columns point into mapped
+    AYS_fixture_store() : offset(1, 0) { }
+};
+
+uint32_t AYS_store_size(const AYS_fixture_store &store){
+    return store.pid.size();
+}
+
+uint32_t AYS_store_participants(const AYS_fixture_store &store, uint32_t row){
+    return store.offset[row+1] - store.offset[row];
+}
+
+void AYS_store_reserve(AYS_fixture_store &store, size_t fixtures, size_t participants){
+    store.start_time.reserve(fixtures);
+    store.expiry_time.reserve(fixtures);
+    store.pid.reserve(fixtures);
+    store.id.reserve(fixtures);
+    store.sid.reserve(fixtures);
+    store.btid.reserve(fixtures);
+    store.line.reserve(fixtures);
+    store.max_nominal_bet.reserve(fixtures);
+    store.currency.reserve(fixtures);
+    store.offset.reserve(fixtures+1);
+    store.participant_ids.reserve(participants);
+    store.participant_not_odds.reserve(participants);
+    store.participant_odds.reserve(participants);
+}
+
+// empties the store, the capacity of the columns is kept for the next book
+void AYS_store_clear(AYS_fixture_store &store){
+    store.start_time.clear();
+    store.expiry_time.clear();
+    store.pid.clear();
+    store.id.clear();
+    store.sid.clear();
+    store.btid.clear();
+    store.line.clear();
+    store.max_nominal_bet.clear();
+    store.currency.clear();
+    store.offset.clear();
+    store.offset.push_back(0);
+    store.participant_ids.clear();
+    store.participant_not_odds.clear();
+    store.participant_odds.clear();
+    store.mapping.reset();
+}
+
+// appends the fixture, its names and currency are interned
+uint32_t AYS_store_push(AYS_fixture_store &store, const AYS_fixture &f){
+    store.start_time.push_back(f.start_time);
+    store.expiry_time.push_back(f.expiry_time);
+    store.pid.push_back(f.pid);
+    store.id.push_back(f.id);
+    store.sid.push_back(f.sid);
+    store.btid.push_back(f.btid);
+    store.line.push_back(f.line);
+    store.max_nominal_bet.push_back(f.max_nominal_bet);
+    store.currency.push_back(AYS_intern(AYS_currencies(), f.currency));
+    for (int j = 0; j < (int)f.participant_names.size(); j++){
+        store.participant_ids.push_back(AYS_intern(AYS_names(), f.participant_names[j]));
+        store.participant_not_odds.push_back(AYS_odds_quantize(f.participant_not_odds[j]));
+        store.participant_odds.push_back(AYS_odds_quantize(f.participant_odds[j]));
+    }
+    store.offset.push_back(store.participant_ids.size());
+    return store.pid.size()-1;
+}
+
+// overwrites row with f, which must have the same amount of participants
+void AYS_store_set(AYS_fixture_store &store, uint32_t row, const AYS_fixture &f){
+    store.start_time[row] = f.start_time;
+    store.expiry_time[row] = f.expiry_time;
+    store.pid[row] = f.pid;
+    store.id[row] = f.id;
+    store.sid[row] = f.sid;
+    store.btid[row] = f.btid;
+    store.line[row] = f.line;
+    store.max_nominal_bet[row] = f.max_nominal_bet;
+    store.currency[row] = AYS_intern(AYS_currencies(), f.currency);
+    uint32_t o = store.offset[row];
+    for (int j = 0; j < (int)f.participant_names.size(); j++){
+        store.participant_ids[o+j] = AYS_intern(AYS_names(), f.participant_names[j]);
+        store.participant_not_odds[o+j] = AYS_odds_quantize(f.participant_not_odds[j]);
+        store.participant_odds[o+j] = AYS_odds_quantize(f.participant_odds[j]);
+    }
+}
+
+/*
+ * Binary snapshot of a fixture book, for warm starts and for handing a book to another process.
+ * A header followed by sections at 64 byte aligned offsets: the fixed width columns of the store as they are in
+ * memory, and the distinct names and currencies as string tables (offsets into a byte blob) that the id columns
+ * index. AYS_snapshot_load maps the file and the store views the columns in place, only the id columns are
+ * rewritten to the ids of the process. The file is for machines of the same byte order and time_t, the loader
+ * refuses anything else.
+ */
+#define AYS_SNAPSHOT_VERSION 2
+#define AYS_SNAPSHOT_ALIGN 64
+
+enum AYS_snapshot_section {
+    AYS_SNAPSHOT_START_TIME,
+    AYS_SNAPSHOT_EXPIRY_TIME,
+    AYS_SNAPSHOT_PID,
+    AYS_SNAPSHOT_ID,
+    AYS_SNAPSHOT_SID,
+    AYS_SNAPSHOT_BTID,
+    AYS_SNAPSHOT_LINE,
+    AYS_SNAPSHOT_MAX_NOMINAL_BET,
+    AYS_SNAPSHOT_CURRENCY, // index into the currency table
+    AYS_SNAPSHOT_OFFSET, // fixtures+1 entries
+    AYS_SNAPSHOT_PARTICIPANT_IDS, // index into the name table
+    AYS_SNAPSHOT_PARTICIPANT_NOT_ODDS,
+    AYS_SNAPSHOT_PARTICIPANT_ODDS,
+    AYS_SNAPSHOT_NAME_OFFSETS, // names+1 uint64_t into the name bytes
+    AYS_SNAPSHOT_NAME_BYTES,
+    AYS_SNAPSHOT_CURRENCY_OFFSETS,
+    AYS_SNAPSHOT_CURRENCY_BYTES,
+    AYS_SNAPSHOT_SECTIONS
+};
+
+struct AYS_snapshot_header {
+    char magic[8]; // "AYSSNAP"
+    uint32_t version;
+    uint32_t byte_order; // 0x01020304 as written
+    uint32_t time_size; // sizeof(time_t)
+    uint32_t sections;
+    uint32_t odds_size; // sizeof(AYS_odd_q)
+    uint32_t odds_fraction_bits; // AYS_ODDS_FRACTION_BITS, 0 for float odds
+    uint64_t fixtures;
+    uint64_t participants;
+    uint64_t names;
+    uint64_t currencies;
+    uint64_t section_offset[AYS_SNAPSHOT_SECTIONS];
+    uint64_t section_bytes[AYS_SNAPSHOT_SECTIONS];
+};
+
+// appends count values value(k) as the next section, padded to the alignment
+template<typename T, typename F>
+bool AYS_snapshot_put(FILE *f, AYS_snapshot_header &header, uint64_t &pos, int section, size_t count, F value){
+    static const char zeros[AYS_SNAPSHOT_ALIGN] = {0};
+    uint64_t start = (pos + AYS_SNAPSHOT_ALIGN-1) & ~(uint64_t)(AYS_SNAPSHOT_ALIGN-1);
+    if (fwrite(zeros, 1, start-pos, f) != start-pos) return false;
+    T chunk[4096];
+    for (size_t k = 0; k < count; k += 4096){
+        size_t n = std::min<size_t>(4096, count-k);
+        for (size_t i = 0; i < n; i++){
+            chunk[i] = value(k+i);
+        }
+        if (fwrite(chunk, sizeof(T), n, f) != n) return false;
+    }
+    header.section_offset[section] = start;
+    header.section_bytes[section] = count*sizeof(T);
+    pos = start + count*sizeof(T);
+    return true;
+}
+
+// the strings of a table as offsets and bytes sections
+bool AYS_snapshot_put_strings(FILE *f, AYS_snapshot_header &header, uint64_t &pos, int section, 
+                              const AYS_intern_table &table, const std::vector<uint32_t> &ids){
+    std::vector<uint64_t> offsets(1, 0);
+    for (uint32_t id : ids){
+        offsets.push_back(offsets.back() + AYS_interned_get(table, id).str.size());
+    }
+    std::string bytes;
+    bytes.reserve(offsets.back());
+    for (uint32_t id : ids){
+        bytes += AYS_interned_get(table, id).str;
+    }
+    return AYS_snapshot_put<uint64_t>(f, header, pos, section, offsets.size(), [&](size_t k){ return offsets[k]; }) 
+        && AYS_snapshot_put<char>(f, header, pos, section+1, bytes.size(), [&](size_t k){ return bytes[k]; });
+}
+
+// writes the rows of the store (all of them without rows) to path through a temporary file and a rename, so a
+// reader never maps a partial snapshot
+bool AYS_snapshot_write(const AYS_fixture_store &store, const std::string &path, const std::vector<uint32_t> *rows = NULL){
+    std::vector<uint32_t> all;
+    if (!rows){
+        all.resize(AYS_store_size(store));
+        for (uint32_t row = 0; row < all.size(); row++){
+            all[row] = row;
+        }
+        rows = &all;
+    }
+    const std::vector<uint32_t> &r = *rows;
+    // the file indexes its own tables of the names and currencies in use, in order of first use
+    std::unordered_map<uint32_t, uint32_t> name_index, currency_index;
+    std::vector<uint32_t> names, currencies;
+    std::vector<uint32_t> offsets(1, 0);
+    std::vector<uint32_t> entries; // store index of every participant written
+    for (uint32_t row : r){
+        if (currency_index.emplace(store.currency[row], currencies.size()).second){
+            currencies.push_back(store.currency[row]);
+        }
+        for (uint32_t o = store.offset[row]; o < store.offset[row+1]; o++){
+            if (name_index.emplace(store.participant_ids[o], names.size()).second){
+                names.push_back(store.participant_ids[o]);
+            }
+            entries.push_back(o);
+        }
+        offsets.push_back(entries.size());
+    }
+
+    AYS_snapshot_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "AYSSNAP", 8);
+    header.version = AYS_SNAPSHOT_VERSION;
+    header.byte_order = 0x01020304;
+    header.time_size = sizeof(time_t);
+    header.sections = AYS_SNAPSHOT_SECTIONS;
+    header.odds_size = sizeof(AYS_odd_q);
+    header.odds_fraction_bits = AYS_ODDS_FRACTION_BITS;
+    header.fixtures = r.size();
+    header.participants = entries.size();
+    header.names = names.size();
+    header.currencies = currencies.size();
+
+    std::string tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f){
+        std::cerr << "could not open " << tmp << std::endl;
+        return false;
+    }
+    uint64_t pos = sizeof(header);
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1; // placeholder until the offsets are known
+    ok = ok && AYS_snapshot_put<time_t>(f, header, pos, AYS_SNAPSHOT_START_TIME, r.size(), [&](size_t k){ return store.start_time[r[k]]; });
+    ok = ok && AYS_snapshot_put<time_t>(f, header, pos, AYS_SNAPSHOT_EXPIRY_TIME, r.size(), [&](size_t k){ return store.expiry_time[r[k]]; });
+    ok = ok && AYS_snapshot_put<AYS_provider_id>(f, header, pos, AYS_SNAPSHOT_PID, r.size(), [&](size_t k){ return store.pid[r[k]]; });
+    ok = ok && AYS_snapshot_put<AYS_fixture_id>(f, header, pos, AYS_SNAPSHOT_ID, r.size(), [&](size_t k){ return store.id[r[k]]; });
+    ok = ok && AYS_snapshot_put<AYS_sport_id>(f, header, pos, AYS_SNAPSHOT_SID, r.size(), [&](size_t k){ return store.sid[r[k]]; });
+    ok = ok && AYS_snapshot_put<AYS_bet_type_id>(f, header, pos, AYS_SNAPSHOT_BTID, r.size(), [&](size_t k){ return store.btid[r[k]]; });
+    ok = ok && AYS_snapshot_put<int>(f, header, pos, AYS_SNAPSHOT_LINE, r.size(), [&](size_t k){ return store.line[r[k]]; });
+    ok = ok && AYS_snapshot_put<float>(f, header, pos, AYS_SNAPSHOT_MAX_NOMINAL_BET, r.size(), [&](size_t k){ return store.max_nominal_bet[r[k]]; });
+    ok = ok && AYS_snapshot_put<uint32_t>(f, header, pos, AYS_SNAPSHOT_CURRENCY, r.size(), [&](size_t k){ return currency_index[store.currency[r[k]]]; });
+    ok = ok && AYS_snapshot_put<uint32_t>(f, header, pos, AYS_SNAPSHOT_OFFSET, offsets.size(), [&](size_t k){ return offsets[k]; });
+    ok = ok && AYS_snapshot_put<uint32_t>(f, header, pos, AYS_SNAPSHOT_PARTICIPANT_IDS, entries.size(), [&](size_t k){ return name_index[store.participant_ids[entries[k]]]; });
+    ok = ok && AYS_snapshot_put<AYS_odd_q>(f, header, pos, AYS_SNAPSHOT_PARTICIPANT_NOT_ODDS, entries.size(), [&](size_t k){ return store.participant_not_odds[entries[k]]; });
+    ok = ok && AYS_snapshot_put<AYS_odd_q>(f, header, pos, AYS_SNAPSHOT_PARTICIPANT_ODDS, entries.size(), [&](size_t k){ return store.participant_odds[entries[k]]; });
+    ok = ok && AYS_snapshot_put_strings(f, header, pos, AYS_SNAPSHOT_NAME_OFFSETS, AYS_names(), names);
+    ok = ok && AYS_snapshot_put_strings(f, header, pos, AYS_SNAPSHOT_CURRENCY_OFFSETS, AYS_currencies(), currencies);
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0){
+        std::cerr << "could not write " << path << std::endl;
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// a read only mapping of a whole file, read into memory where there is no mmap
+struct AYS_mapped_file {
+    const char *data;
+    size_t size;
+    std::vector<char> buffer;
+    AYS_mapped_file() : data(NULL), size(0) { }
+    ~AYS_mapped_file(){
+#ifndef _WIN32
+        if (data) munmap((void *)data, size);
+#endif
+    }
+};
+
+std::shared_ptr<AYS_mapped_file> AYS_map_file(const std::string &path){
+    std::shared_ptr<AYS_mapped_file> file = std::make_shared<AYS_mapped_file>();
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0){
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    file->data = (const char *)data;
+    file->size = st.st_size;
+#else
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return NULL;
+    char chunk[1 << 16];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0){
+        file->buffer.insert(file->buffer.end(), chunk, chunk+n);
+    }
+    fclose(f);
+    file->data = file->buffer.data();
+    file->size = file->buffer.size();
+#endif
+    return file;
+}
+
+// interns the strings of a snapshot table, ids[k] is the process id of string k
+bool AYS_snapshot_strings(const AYS_mapped_file &file, const AYS_snapshot_header &header, int section, uint64_t strings, 
+                          AYS_intern_table &table, std::vector<uint32_t> &ids){
+    if (header.section_bytes[section] != (strings+1)*sizeof(uint64_t)) return false;
+    const uint64_t *offsets = (const uint64_t *)(file.data + header.section_offset[section]);
+    const char *bytes = file.data + header.section_offset[section+1];
+    ids.resize(strings);
+    for (uint64_t k = 0; k < strings; k++){
+        if (offsets[k] > offsets[k+1] || offsets[k+1] > header.section_bytes[section+1]) return false;
+        ids[k] = AYS_intern(table, std::string(bytes + offsets[k], offsets[k+1]-offsets[k]));
+    }
+    return true;
+}
+
+// maps a snapshot written by AYS_snapshot_write, NULL if it cannot be read. The fixed width columns of the store
+// view the mapping until they are written to
+std::shared_ptr<AYS_fixture_store> AYS_snapshot_load(const std::string &path){
+    std::shared_ptr<AYS_mapped_file> file = AYS_map_file(path);
+    if (!file){
+        std::cerr << "could not map " << path << std::endl;
+        return NULL;
+    }
+    AYS_snapshot_header header;
+    if (file->size < sizeof(header)){
+        std::cerr << path << " is not a snapshot" << std::endl;
+        return NULL;
+    }
+    memcpy(&header, file->data, sizeof(header));
+    if (memcmp(header.magic, "AYSSNAP", 8) != 0 || header.version != AYS_SNAPSHOT_VERSION || header.byte_order != 0x01020304 
+        || header.time_size != sizeof(time_t) || header.sections != AYS_SNAPSHOT_SECTIONS 
+        || header.odds_size != sizeof(AYS_odd_q) || header.odds_fraction_bits != AYS_ODDS_FRACTION_BITS){
+        std::cerr << path << " is not a version " << AYS_SNAPSHOT_VERSION << " snapshot of this platform and odds format" << std::endl;
+        return NULL;
+    }
+    uint64_t fixtures = header.fixtures;
+    uint64_t participants = header.participants;
+    const uint64_t counts[AYS_SNAPSHOT_SECTIONS] = {fixtures, fixtures, fixtures, fixtures, fixtures, fixtures, fixtures, fixtures, fixtures, 
+                                                    fixtures+1, participants, participants, participants, 
+                                                    header.names+1, header.section_bytes[AYS_SNAPSHOT_NAME_BYTES], 
+                                                    header.currencies+1, header.section_bytes[AYS_SNAPSHOT_CURRENCY_BYTES]};
+    const size_t sizes[AYS_SNAPSHOT_SECTIONS] = {sizeof(time_t), sizeof(time_t), sizeof(AYS_provider_id), sizeof(AYS_fixture_id), 
+                                                 sizeof(AYS_sport_id), sizeof(AYS_bet_type_id), sizeof(int), sizeof(float), 
+                                                 sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t), sizeof(AYS_odd_q), sizeof(AYS_odd_q), 
+                                                 sizeof(uint64_t), 1, sizeof(uint64_t), 1};
+    for (int section = 0; section < AYS_SNAPSHOT_SECTIONS; section++){
+        uint64_t offset = header.section_offset[section];
+        uint64_t bytes = header.section_bytes[section];
+        if (bytes != counts[section]*sizes[section] || offset % AYS_SNAPSHOT_ALIGN != 0 || offset > file->size || bytes > file->size - offset){
+            std::cerr << path << " is truncated or corrupt" << std::endl;
+            return NULL;
+        }
+    }
+    std::vector<uint32_t> name_ids, currency_ids;
+    if (!AYS_snapshot_strings(*file, header, AYS_SNAPSHOT_NAME_OFFSETS, header.names, AYS_names(), name_ids) 
+        || !AYS_snapshot_strings(*file, header, AYS_SNAPSHOT_CURRENCY_OFFSETS, header.currencies, AYS_currencies(), currency_ids)){
+        std::cerr << path << " has a corrupt string table" << std::endl;
+        return NULL;
+    }
+    auto section = [&](int s){ return file->data + header.section_offset[s]; };
+    const uint32_t *offset = (const uint32_t *)section(AYS_SNAPSHOT_OFFSET);
+    const uint32_t *currency = (const uint32_t *)section(AYS_SNAPSHOT_CURRENCY);
+    const uint32_t *participant_ids = (const uint32_t *)section(AYS_SNAPSHOT_PARTICIPANT_IDS);
+    bool valid = offset[0] == 0 && offset[fixtures] == participants;
+    for (uint64_t row = 0; valid && row < fixtures; row++){
+        valid = offset[row] <= offset[row+1] && currency[row] < header.currencies;
+    }
+    for (uint64_t o = 0; valid && o < participants; o++){
+        valid = participant_ids[o] < header.names;
+    }
+    if (!valid){
+        std::cerr << path << " is truncated or corrupt" << std::endl;
+        return NULL;
+    }
+
+    std::shared_ptr<AYS_fixture_store> store = std::make_shared<AYS_fixture_store>();
+    store->mapping = file;
+    store->start_time.view((const time_t *)section(AYS_SNAPSHOT_START_TIME), fixtures);
+    store->expiry_time.view((const time_t *)section(AYS_SNAPSHOT_EXPIRY_TIME), fixtures);
+    store->pid.view((const AYS_provider_id *)section(AYS_SNAPSHOT_PID), fixtures);
+    store->id.view((const AYS_fixture_id *)section(AYS_SNAPSHOT_ID), fixtures);
+    store->sid.view((const AYS_sport_id *)section(AYS_SNAPSHOT_SID), fixtures);
+    store->btid.view((const AYS_bet_type_id *)section(AYS_SNAPSHOT_BTID), fixtures);
+    store->line.view((const int *)section(AYS_SNAPSHOT_LINE), fixtures);
+    store->max_nominal_bet.view((const float *)section(AYS_SNAPSHOT_MAX_NOMINAL_BET), fixtures);
+    store->offset.view(offset, fixtures+1);
+    store->participant_not_odds.view((const AYS_odd_q *)section(AYS_SNAPSHOT_PARTICIPANT_NOT_ODDS), participants);
+    store->participant_odds.view((const AYS_odd_q *)section(AYS_SNAPSHOT_PARTICIPANT_ODDS), participants);
+    // the ids of this process
+    store->currency.reserve(fixtures);
+    for (uint64_t row = 0; row < fixtures; row++){
+        store->currency.push_back(currency_ids[currency[row]]);
+    }
+    store->participant_ids.reserve(participants);
+    for (uint64_t o = 0; o < participants; o++){
+        store->participant_ids.push_back(name_ids[participant_ids[o]]);
+    }
+    return store;
+}
+
+struct AYS_event {
+    time_t start_time;
+    AYS_sport_id sid;
+    AYS_bet_type_id btid;
+    int line;
+    float arb;
+    float not_arb;
+    float roi;
+    uint32_t arb_flags;
+    int participants;
+    AYS_arena_vector<float> participant_stakes;
+    std::shared_ptr<const AYS_fixture_store> store;
+    // the vectors share the allocator of fixtures, events of a scan with a scan arena live in it
+    AYS_arena_vector<uint32_t> fixtures; // rows in store
+    AYS_arena_vector<uint8_t> slots; // slots[i*participants+j] is the participant of fixtures[i] matched to participant j
+    AYS_arena_vector<int> max_idx; // fixture with the best odds per participant, -1 if none, set by AYS_event_arb
+    AYS_arena_vector<int> max_not_idx; // same for the not odds
+    int max_not_arb_idx;
+    AYS_event(std::shared_ptr<const AYS_fixture_store> store, AYS_arena_vector<uint32_t> &fixtures, AYS_arena_vector<uint8_t> &slots) 
+        : start_time(store->start_time[fixtures[0]])
+        , sid(store->sid[fixtures[0]])
+        , btid(store->btid[fixtures[0]])
+        , line(store->line[fixtures[0]])
+        , participants(AYS_store_participants(*store, fixtures[0]))
+        , participant_stakes(participants, 0, fixtures.get_allocator())
+        , store(std::move(store))
+        , fixtures(std::move(fixtures))
+        , slots(std::move(slots))
+        , max_idx(this->fixtures.get_allocator())
+        , max_not_idx(this->fixtures.get_allocator()) {
+        arb = std::numeric_limits<float>::infinity();
+        not_arb = std::numeric_limits<float>::infinity();
+        roi = -1;
+        max_not_arb_idx = 0;
+        // AYS_events_arb fills them from the worker threads, which must not allocate from another worker's arena
+        max_idx.reserve(participants);
+        max_not_idx.reserve(participants);
+    }
+    // participant j of fixture i in the event's participant order
+    uint32_t participant_idx(int i, int j) const {
+        return store->offset[fixtures[i]] + slots[i*participants + j];
+    }
+    // the stored odds, exact to compare
+    AYS_odd_q odd_q(int i, int j) const {
+        return store->participant_odds[participant_idx(i, j)];
+    }
+    AYS_odd_q not_odd_q(int i, int j) const {
+        return store->participant_not_odds[participant_idx(i, j)];
+    }
+    AYS_odd odd(int i, int j) const {
+        return AYS_odds_float(odd_q(i, j));
+    }
+    AYS_odd not_odd(int i, int j) const {
+        return AYS_odds_float(not_odd_q(i, j));
+    }
+    AYS_name_id name_id(int i, int j) const {
+        return store->participant_ids[participant_idx(i, j)];
+    }
+    const AYS_participant &name(int i, int j) const {
+        return AYS_name(name_id(i, j));
+    }
+    const AYS_participant &participant_name(int j) const {
+        return name(0, j);
+    }
+    float max_nominal_bet(int i) const {
+        return store->max_nominal_bet[fixtures[i]];
+    }
+};
+
+// fixture i of the event with its participants in the event's order
+AYS_fixture AYS_event_fixture(const AYS_event &event, int i){
+    uint32_t row = event.fixtures[i];
+    std::vector<AYS_participant> names(event.participants);
+    std::vector<AYS_odd> not_odds(event.participants);
+    std::vector<AYS_odd> odds(event.participants);
+    for (int j = 0; j < event.participants; j++){
+        names[j] = event.name(i, j);
+        not_odds[j] = event.not_odd(i, j);
+        odds[j] = event.odd(i, j);
+    }
+    const AYS_fixture_store &s = *event.store;
+    return AYS_fixture(s.start_time[row], s.expiry_time[row], s.pid[row], s.id[row], s.sid[row], s.btid[row], s.line[row], 
+                       AYS_currency(s.currency[row]), s.max_nominal_bet[row], names, not_odds, odds);
+}
+
+
+// thread safe replacement for std::localtime + std::strftime
+void AYS_time_to_string(time_t t, char *buffer, size_t size){
+    std::tm tm;
+#ifdef _WIN32
+    localtime_s(&tm, &t);
+#else
+    localtime_r(&t, &tm);
+#endif
+    std::strftime(buffer, size, "%d/%m-%YT%H:%M:%S", &tm);
+}
+
+// index of the fixture with the lowest (inverse) odds per participant, -1 if no fixture is below 1
+void AYS_event_best(const AYS_event &event, AYS_arena_vector<int> &max_idx, AYS_arena_vector<int> &max_not_idx){
+    max_idx.assign(event.participants,-1);
+    max_not_idx.assign(event.participants,-1);
+    std::vector<AYS_odd_q> max_odds(event.participants,AYS_ODDS_ONE);
+    std::vector<AYS_odd_q> max_not_odds(event.participants,AYS_ODDS_ONE);
+    for (int i = 0; i < (int)event.fixtures.size(); i++){
+        for (int j = 0; j < (int)max_odds.size();j++){
+            if (max_odds[j] > event.odd_q(i, j)){
+                max_odds[j] = event.odd_q(i, j); 
+                max_idx[j] = i; 
+            }
+            if (max_not_odds[j] > event.not_odd_q(i, j)){
+                max_not_odds[j] = event.not_odd_q(i, j); 
+                max_not_idx[j] = i; 
+            }
+        }
+    }
+}
+
+// best odds per participant from the AYS_event_best indices
+void AYS_event_best_odds(const AYS_event &event, const int *max_idx, const int *max_not_idx, 
+                         std::vector<float> &max_odds, std::vector<float> &max_not_odds){
+    max_odds.resize(event.participants);
+    max_not_odds.resize(event.participants);
+    for (int j = 0; j < event.participants; j++){
+        max_odds[j] = max_idx[j] < 0 ? 1 : event.odd(max_idx[j], j);
+        max_not_odds[j] = max_not_idx[j] < 0 ? 1 : event.not_odd(max_not_idx[j], j);
+    }
+}
+
+bool AYS_event_arb(AYS_event &event){
+    for (int i = 0; i < (int)event.fixtures.size(); i++){
+        if ((int)AYS_store_participants(*event.store, event.fixtures[i]) != event.participants){
+            std::cerr << "diffent amount of outcomes in fixtures 0 and " << i << "\n" 
+                      << AYS_event_to_string(event) << std::endl;
+            return false;
+        }
+    }
+    std::vector<float> max_odds;
+    std::vector<float> max_not_odds;
+    AYS_event_best(event, event.max_idx, event.max_not_idx);
+    AYS_event_best_odds(event, event.max_idx.data(), event.max_not_idx.data(), max_odds, max_not_odds);
+    float per = 0;
+    event.not_arb = std::numeric_limits<float>::infinity();
+    for (int i = 0; i < (int)max_odds.size(); i++){
+        per += max_odds[i];
+        if (event.not_arb > max_odds[i]+max_not_odds[i]){
+            event.not_arb = max_odds[i]+max_not_odds[i];
+            event.max_not_arb_idx = i;
+        }
+
+    }
+    event.arb = per;
+    event.roi = 100/std::min(per, event.not_arb)-100;
+    return true;
+}
+
+/*
+ * Batch arb evaluation.
+ * Events with the same participant count are packed AYS_ARB_LANES at a time, one event per lane, into
+ * [fixture][participant][lane] odds blocks padded with 1 (no price). The min reductions, arg-mins and the
+ * arb/not_arb sums then run across lanes, with AVX2 when the cpu has it and a scalar loop otherwise.
+ * The results, including the best fixture per participant, are written back into the events.
+ * Quantized odds fill 16 int16 lanes of a vector, the sums are widened to int32 halves of 8 lanes.
+ */
+#ifdef AYS_QUANTIZED_ODDS
+#define AYS_ARB_LANES 16
+#else
+#define AYS_ARB_LANES 8
+#endif
+
+struct AYS_arb_block {
+    int participants;
+    int fixtures;
+    uint32_t odds_offset; // into odds/not_odds, participants*fixtures*AYS_ARB_LANES floats
+    uint32_t best_offset; // into the best_* outputs, participants*AYS_ARB_LANES entries
+};
+
+struct AYS_arb_batch {
+    AYS_arena_vector<uint32_t> order; // the events by participant count
+    AYS_arena_vector<AYS_arb_block> blocks;
+    AYS_arena_vector<uint32_t> lane_event; // event per block lane, UINT32_MAX for padding
+    AYS_arena_vector<AYS_odd_q> odds;
+    AYS_arena_vector<AYS_odd_q> not_odds;
+    // outputs
+    AYS_arena_vector<AYS_odd_q> best_odds;
+    AYS_arena_vector<AYS_odd_q> best_not_odds;
+    AYS_arena_vector<int32_t> best_idx;
+    AYS_arena_vector<int32_t> best_not_idx;
+    AYS_arena_vector<AYS_odd_sum> arb; // per block lane
+    AYS_arena_vector<AYS_odd_sum> not_arb;
+    AYS_arena_vector<int32_t> not_arb_idx;
+    bool use_avx2;
+    AYS_arb_batch(AYS_arena *arena = NULL) 
+        : order(arena)
+        , blocks(arena)
+        , lane_event(arena)
+        , odds(arena)
+        , not_odds(arena)
+        , best_odds(arena)
+        , best_not_odds(arena)
+        , best_idx(arena)
+        , best_not_idx(arena)
+        , arb(arena)
+        , not_arb(arena)
+        , not_arb_idx(arena)
+        , use_avx2(false) {
+#ifdef AYS_X86
+        use_avx2 = __builtin_cpu_supports("avx2");
+#endif
+    }
+};
+
+void AYS_arb_batch_pack(AYS_arb_batch &batch, const std::vector<AYS_event> &events, const AYS_arena_vector<uint32_t> *subset){
+    AYS_arena_vector<uint32_t> &order = batch.order;
+    if (subset){
+        order.assign(subset->begin(), subset->end());
+    } else {
+        order.resize(events.size());
+        for (uint32_t e = 0; e < order.size(); e++){
+            order[e] = e;
+        }
+    }
+    // the lanes are independent, any order works, std::sort just does not take a buffer like std::stable_sort
+    std::sort(order.begin(), order.end(), [&](uint32_t e1, uint32_t e2){ 
+        return events[e1].participants < events[e2].participants || (events[e1].participants == events[e2].participants && e1 < e2); 
+    });
+    batch.blocks.clear();
+    batch.lane_event.clear();
+    uint32_t odds_size = 0;
+    uint32_t best_size = 0;
+    for (int start = 0; start < (int)order.size(); ){
+        AYS_arb_block block;
+        block.participants = events[order[start]].participants;
+        block.fixtures = 0;
+        int end = start;
+        while (end < (int)order.size() && end-start < AYS_ARB_LANES && events[order[end]].participants == block.participants){
+            block.fixtures = std::max(block.fixtures, (int)events[order[end]].fixtures.size());
+            batch.lane_event.push_back(order[end++]);
+        }
+        batch.lane_event.resize(batch.blocks.size()*AYS_ARB_LANES + AYS_ARB_LANES, UINT32_MAX);
+        block.odds_offset = odds_size;
+        block.best_offset = best_size;
+        odds_size += block.participants*block.fixtures*AYS_ARB_LANES;
+        best_size += block.participants*AYS_ARB_LANES;
+        batch.blocks.push_back(block);
+        start = end;
+    }
+    batch.odds.assign(odds_size, AYS_ODDS_ONE);
+    batch.not_odds.assign(odds_size, AYS_ODDS_ONE);
+    for (int b = 0; b < (int)batch.blocks.size(); b++){
+        const AYS_arb_block &block = batch.blocks[b];
+        for (int lane = 0; lane < AYS_ARB_LANES; lane++){
+            uint32_t e = batch.lane_event[b*AYS_ARB_LANES + lane];
+            if (e == UINT32_MAX) continue;
+            const AYS_event &event = events[e];
+            for (int i = 0; i < (int)event.fixtures.size(); i++){
+                for (int j = 0; j < block.participants; j++){
+                    uint32_t o = block.odds_offset + (i*block.participants + j)*AYS_ARB_LANES + lane;
+                    batch.odds[o] = event.odd_q(i, j);
+                    batch.not_odds[o] = event.not_odd_q(i, j);
+                }
+            }
+        }
+    }
+    batch.best_odds.resize(best_size);
+    batch.best_not_odds.resize(best_size);
+    batch.best_idx.resize(best_size);
+    batch.best_not_idx.resize(best_size);
+    batch.arb.resize(batch.lane_event.size());
+    batch.not_arb.resize(batch.lane_event.size());
+    batch.not_arb_idx.resize(batch.lane_event.size());
+}
+
+void AYS_arb_block_scalar(AYS_arb_batch &batch, int b){
+    const AYS_arb_block &block = batch.blocks[b];
+    const int n = block.participants;
+    for (int lane = 0; lane < AYS_ARB_LANES; lane++){
+        AYS_odd_sum per = 0;
+        AYS_odd_sum not_arb = AYS_odds_sum_max();
+        int not_arb_idx = 0;
+        for (int j = 0; j < n; j++){
+            AYS_odd_q mo = AYS_ODDS_ONE, mno = AYS_ODDS_ONE;
+            int mi = -1, mni = -1;
+            for (int i = 0; i < block.fixtures; i++){
+                uint32_t o = block.odds_offset + (i*n + j)*AYS_ARB_LANES + lane;
+                if (mo > batch.odds[o]){
+                    mo = batch.odds[o];
+                    mi = i;
+                }
+                if (mno > batch.not_odds[o]){
+                    mno = batch.not_odds[o];
+                    mni = i;
+                }
+            }
+            uint32_t best = block.best_offset + j*AYS_ARB_LANES + lane;
+            batch.best_odds[best] = mo;
+            batch.best_not_odds[best] = mno;
+            batch.best_idx[best] = mi;
+            batch.best_not_idx[best] = mni;
+            per += mo;
+            if (not_arb > (AYS_odd_sum)mo+mno){
+                not_arb = (AYS_odd_sum)mo+mno;
+                not_arb_idx = j;
+            }
+        }
+        batch.arb[b*AYS_ARB_LANES + lane] = per;
+        batch.not_arb[b*AYS_ARB_LANES + lane] = not_arb;
+        batch.not_arb_idx[b*AYS_ARB_LANES + lane] = not_arb_idx;
+    }
+}
+
+#if defined(AYS_X86) && defined(AYS_QUANTIZED_ODDS)
+__attribute__((target("avx2")))
+void AYS_arb_block_avx2(AYS_arb_batch &batch, int b){
+    const AYS_arb_block &block = batch.blocks[b];
+    const int n = block.participants;
+    const __m256i one = _mm256_set1_epi16(AYS_ODDS_ONE);
+    __m256i per[2] = {_mm256_setzero_si256(), _mm256_setzero_si256()};
+    __m256i not_arb[2] = {_mm256_set1_epi32(std::numeric_limits<int32_t>::max()), _mm256_set1_epi32(std::numeric_limits<int32_t>::max())};
+    __m256i not_arb_idx[2] = {_mm256_setzero_si256(), _mm256_setzero_si256()};
+    for (int j = 0; j < n; j++){
+        __m256i mo = one, mno = one;
+        __m256i mi = _mm256_set1_epi16(-1), mni = mi;
+        const AYS_odd_q *odds = &batch.odds[block.odds_offset + j*AYS_ARB_LANES];
+        const AYS_odd_q *not_odds = &batch.not_odds[block.odds_offset + j*AYS_ARB_LANES];
+        for (int i = 0; i < block.fixtures; i++){
+            __m256i idx = _mm256_set1_epi16(i);
+            __m256i o = _mm256_loadu_si256((const __m256i *)(odds + i*n*AYS_ARB_LANES));
+            __m256i lt = _mm256_cmpgt_epi16(mo, o);
+            mo = _mm256_min_epi16(mo, o);
+            mi = _mm256_blendv_epi8(mi, idx, lt);
+            __m256i no = _mm256_loadu_si256((const __m256i *)(not_odds + i*n*AYS_ARB_LANES));
+            __m256i nlt = _mm256_cmpgt_epi16(mno, no);
+            mno = _mm256_min_epi16(mno, no);
+            mni = _mm256_blendv_epi8(mni, idx, nlt);
+        }
+        uint32_t best = block.best_offset + j*AYS_ARB_LANES;
+        _mm256_storeu_si256((__m256i *)&batch.best_odds[best], mo);
+        _mm256_storeu_si256((__m256i *)&batch.best_not_odds[best], mno);
+        for (int h = 0; h < 2; h++){ // lanes 8h..8h+7 in int32
+            __m128i mo_h = h ? _mm256_extracti128_si256(mo, 1) : _mm256_castsi256_si128(mo);
+            __m128i mno_h = h ? _mm256_extracti128_si256(mno, 1) : _mm256_castsi256_si128(mno);
+            __m128i mi_h = h ? _mm256_extracti128_si256(mi, 1) : _mm256_castsi256_si128(mi);
+            __m128i mni_h = h ? _mm256_extracti128_si256(mni, 1) : _mm256_castsi256_si128(mni);
+            _mm256_storeu_si256((__m256i *)&batch.best_idx[best + 8*h], _mm256_cvtepi16_epi32(mi_h));
+            _mm256_storeu_si256((__m256i *)&batch.best_not_idx[best + 8*h], _mm256_cvtepi16_epi32(mni_h));
+            __m256i mo32 = _mm256_cvtepi16_epi32(mo_h);
+            __m256i sum = _mm256_add_epi32(mo32, _mm256_cvtepi16_epi32(mno_h));
+            per[h] = _mm256_add_epi32(per[h], mo32);
+            __m256i lt = _mm256_cmpgt_epi32(not_arb[h], sum);
+            not_arb[h] = _mm256_min_epi32(not_arb[h], sum);
+            not_arb_idx[h] = _mm256_blendv_epi8(not_arb_idx[h], _mm256_set1_epi32(j), lt);
+        }
+    }
+    for (int h = 0; h < 2; h++){
+        _mm256_storeu_si256((__m256i *)&batch.arb[b*AYS_ARB_LANES + 8*h], per[h]);
+        _mm256_storeu_si256((__m256i *)&batch.not_arb[b*AYS_ARB_LANES + 8*h], not_arb[h]);
+        _mm256_storeu_si256((__m256i *)&batch.not_arb_idx[b*AYS_ARB_LANES + 8*h], not_arb_idx[h]);
+    }
+}
+#elif defined(AYS_X86)
+__attribute__((target("avx2")))
+void AYS_arb_block_avx2(AYS_arb_batch &batch, int b){
+    const AYS_arb_block &block = batch.blocks[b];
+    const int n = block.participants;
+    const __m256 one = _mm256_set1_ps(1);
+    __m256 per = _mm256_setzero_ps();
+    __m256 not_arb = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    __m256i not_arb_idx = _mm256_setzero_si256();
+    for (int j = 0; j < n; j++){
+        __m256 mo = one, mno = one;
+        __m256i mi = _mm256_set1_epi32(-1), mni = mi;
+        const float *odds = &batch.odds[block.odds_offset + j*AYS_ARB_LANES];
+        const float *not_odds = &batch.not_odds[block.odds_offset + j*AYS_ARB_LANES];
+        for (int i = 0; i < block.fixtures; i++){
+            __m256i idx = _mm256_set1_epi32(i);
+            __m256 o = _mm256_loadu_ps(odds + i*n*AYS_ARB_LANES);
+            __m256 lt = _mm256_cmp_ps(o, mo, _CMP_LT_OQ);
+            mo = _mm256_blendv_ps(mo, o, lt);
+            mi = _mm256_blendv_epi8(mi, idx, _mm256_castps_si256(lt));
+            __m256 no = _mm256_loadu_ps(not_odds + i*n*AYS_ARB_LANES);
+            __m256 nlt = _mm256_cmp_ps(no, mno, _CMP_LT_OQ);
+            mno = _mm256_blendv_ps(mno, no, nlt);
+            mni = _mm256_blendv_epi8(mni, idx, _mm256_castps_si256(nlt));
+        }
+        uint32_t best = block.best_offset + j*AYS_ARB_LANES;
+        _mm256_storeu_ps(&batch.best_odds[best], mo);
+        _mm256_storeu_ps(&batch.best_not_odds[best], mno);
+        _mm256_storeu_si256((__m256i *)&batch.best_idx[best], mi);
+        _mm256_storeu_si256((__m256i *)&batch.best_not_idx[best], mni);
+        per = _mm256_add_ps(per, mo);
+        __m256 sum = _mm256_add_ps(mo, mno);
+        __m256 lt = _mm256_cmp_ps(sum, not_arb, _CMP_LT_OQ);
+        not_arb = _mm256_blendv_ps(not_arb, sum, lt);
+        not_arb_idx = _mm256_blendv_epi8(not_arb_idx, _mm256_set1_epi32(j), _mm256_castps_si256(lt));
+    }
+    _mm256_storeu_ps(&batch.arb[b*AYS_ARB_LANES], per);
+    _mm256_storeu_ps(&batch.not_arb[b*AYS_ARB_LANES], not_arb);
+    _mm256_storeu_si256((__m256i *)&batch.not_arb_idx[b*AYS_ARB_LANES], not_arb_idx);
+}
+#endif
+
+void AYS_arb_batch_run(AYS_arb_batch &batch){
+    for (int b = 0; b < (int)batch.blocks.size(); b++){
+#ifdef AYS_X86
+        // the quantized kernel keeps the fixture indices in int16 lanes
+        if (batch.use_avx2 && (!std::is_integral<AYS_odd_q>::value || batch.blocks[b].fixtures <= std::numeric_limits<int16_t>::max())){
+            AYS_arb_block_avx2(batch, b);
+            continue;
+        }
+#endif
+        AYS_arb_block_scalar(batch, b);
+    }
+}
+
+// AYS_event_arb for events[subset], or all of them when subset is NULL
+void AYS_events_arb(std::vector<AYS_event> &events, AYS_arb_batch &batch, const AYS_arena_vector<uint32_t> *subset = NULL){
+    AYS_arb_batch_pack(batch, events, subset);
+    AYS_arb_batch_run(batch);
+    for (int b = 0; b < (int)batch.blocks.size(); b++){
+        const AYS_arb_block &block = batch.blocks[b];
+        for (int lane = 0; lane < AYS_ARB_LANES; lane++){
+            uint32_t e = batch.lane_event[b*AYS_ARB_LANES + lane];
+            if (e == UINT32_MAX) continue;
+            AYS_event &event = events[e];
+            event.max_idx.resize(block.participants);
+            event.max_not_idx.resize(block.participants);
+            for (int j = 0; j < block.participants; j++){
+                event.max_idx[j] = batch.best_idx[block.best_offset + j*AYS_ARB_LANES + lane];
+                event.max_not_idx[j] = batch.best_not_idx[block.best_offset + j*AYS_ARB_LANES + lane];
+            }
+            event.arb = AYS_odds_float(batch.arb[b*AYS_ARB_LANES + lane]);
+            event.not_arb = AYS_odds_float(batch.not_arb[b*AYS_ARB_LANES + lane]);
+            event.max_not_arb_idx = batch.not_arb_idx[b*AYS_ARB_LANES + lane];
+            event.roi = 100/std::min(event.arb, event.not_arb)-100;
+        }
+    }
+}
+
+// the best fixture per participant, as found by AYS_event_arb when it ran on the event
+void AYS_event_best_legs(const AYS_event &event, std::vector<int> &max_idx, std::vector<int> &max_not_idx){
+    if ((int)event.max_idx.size() == event.participants){ // already found by AYS_event_arb
+        max_idx.assign(event.max_idx.begin(), event.max_idx.end());
+        max_not_idx.assign(event.max_not_idx.begin(), event.max_not_idx.end());
+    } else {
+        AYS_arena_vector<int> best_idx, best_not_idx;
+        AYS_event_best(event, best_idx, best_not_idx);
+        max_idx.assign(best_idx.begin(), best_idx.end());
+        max_not_idx.assign(best_not_idx.begin(), best_not_idx.end());
+    }
+}
+
+// stakes for the max profit on the best odds of AYS_event_best_odds, returns the profit
+float AYS_event_stakes(const AYS_event &event, const std::vector<int> &max_idx, const std::vector<int> &max_not_idx, 
+                       const std::vector<float> &max_odds, const std::vector<float> &max_not_odds, std::vector<float> &stakes){
+    float max_total_stake = std::numeric_limits<float>::infinity();
+    float total_percentage_odds = std::min(event.not_arb,event.arb);
+    if (event.arb <= event.not_arb){
+        stakes.resize(event.participants,0);
+        for (int idx = 0; idx < event.participants; idx++){
+            if (max_idx[idx] < 0) continue; // no price, no bet
+            float potential_stake = event.max_nominal_bet(max_idx[idx])*total_percentage_odds/max_odds[idx];
+            if (max_total_stake > potential_stake) {
+                max_total_stake = potential_stake;
+            }
+        }
+        if (std::isinf(max_total_stake)) max_total_stake = 0; // nothing priced
+        for (int idx = 0; idx < event.participants; idx++){
+            stakes[idx] = max_total_stake*max_odds[idx]/total_percentage_odds;
+        }
+    } else {
+        stakes.resize(2,0);
+        int idx = event.max_not_arb_idx;
+        if (max_idx[idx] >= 0){
+            max_total_stake = event.max_nominal_bet(max_idx[idx])*total_percentage_odds/max_odds[idx];
+        }
+        if (max_not_idx[idx] >= 0){
+            max_total_stake = std::min(max_total_stake, event.max_nominal_bet(max_not_idx[idx])*total_percentage_odds/max_not_odds[idx]);
+        }
+        if (std::isinf(max_total_stake)) max_total_stake = 0;
+        stakes[0] = max_total_stake*max_odds[idx]/total_percentage_odds;
+        stakes[1] = max_total_stake*max_not_odds[idx]/total_percentage_odds;
+    }
+    return max_total_stake/total_percentage_odds-max_total_stake;
+}
+
+bool AYS_event_max_arb_stakes(const AYS_event &event, std::vector<float> &stakes, std::vector<int> &max_idx, std::vector<int> &max_not_idx, float *max_profit){
+    AYS_event_best_legs(event, max_idx, max_not_idx);
+    std::vector<float> max_odds;
+    std::vector<float> max_not_odds;
+    AYS_event_best_odds(event, max_idx.data(), max_not_idx.data(), max_odds, max_not_odds);
+    *max_profit = AYS_event_stakes(event, max_idx, max_not_idx, max_odds, max_not_odds, stakes);
+    return true;
+}
+
+
+std::string AYS_event_to_string_pretty(const AYS_event &event, std::vector<std::string> provider_names) {
+    bool not_odds = event.not_arb < event.arb;
+    char buffer[32];
+    AYS_time_to_string(event.start_time, buffer, 32);
+    std::vector<float> stakes; 
+    std::vector<int> max_idx; 
+    std::vector<int> max_not_idx; 
+    std::vector<float> max_odds;
+    std::vector<float> max_not_odds;
+    AYS_event_best_legs(event, max_idx, max_not_idx);
+    AYS_event_best_odds(event, max_idx.data(), max_not_idx.data(), max_odds, max_not_odds);
+    float max_profit = AYS_event_stakes(event, max_idx, max_not_idx, max_odds, max_not_odds, stakes);
+    std::string result = fmt::format("@ {} sid: {} btid: {}{} {}ARB: {:.2f}% ROI: {:.2f}% profit: {:.2f} assuming same currency\n\t", buffer, event.sid, event.btid, 
+                          (event.line?fmt::format(" line: {}",event.line):""),
+                          event.arb <= event.not_arb?"":"n", 
+                          std::min(event.arb,event.not_arb)*100,
+                          event.roi,
+                          max_profit);
+
+    int min_width = 5;
+    if (not_odds){
+        int width = std::max(min_width,(int)event.participant_name(event.max_not_arb_idx).size());
+        int not_width = std::max(min_width,(int)event.participant_name(event.max_not_arb_idx).size()+4);
+        result += fmt::format("{0:^{1}.2f} | {2:^{3}.2f}", stakes[0], width, stakes[1], not_width); 
+        result += " <- stakes for max profit\n"; 
+        result += fmt::format("\t{0:^{1}} | Not {0:^{1}}", event.participant_name(event.max_not_arb_idx), min_width);
+    } else {
+        for (int i = 0; i < (int) stakes.size(); i++ ){
+            int width = std::max(min_width,(int)event.participant_name(i).size());
+            result += fmt::format("{:^{}.2f} | ", stakes[i], width); 
+        }
+        result += " <- stakes for max profit\n"; 
+        result += fmt::format("\t{:^{}}", event.participant_name(0), min_width);
+        for (int i = 1; i< event.participants; i++){
+            result += fmt::format(" | {:^{}}", event.participant_name(i), min_width);
+        }
+    }
+    result += " | max bet | currency | provider | event id \n";
+    for (int i = 0; i < (int)event.fixtures.size(); i++){
+        bool is_maximal = false;
+        if (not_odds){
+            is_maximal = event.not_odd(i, event.max_not_arb_idx) == max_not_odds[event.max_not_arb_idx]
+                       || event.odd(i, event.max_not_arb_idx) == max_odds[event.max_not_arb_idx];
+        } else {
+            for (int idx = 0; idx < event.participants; idx++){
+                is_maximal |= event.odd(i, idx) == max_odds[idx];
+            } 
+        }
+        if (!is_maximal) continue;
+        result += "\t";
+        std::string s = " ";
+        if (not_odds){
+            int width = std::max(min_width,(int)event.participant_name(event.max_not_arb_idx).size());
+            s = " ";
+            if (event.odd(i, event.max_not_arb_idx) < 1.){
+                s = fmt::format("{:.2f}", 1/event.odd(i, event.max_not_arb_idx)); 
+            }
+            result += fmt::format("{:^{}}", s, width); 
+            width = std::max(min_width,(int)event.participant_name(event.max_not_arb_idx).size()+4);
+            s = " ";
+            if (event.not_odd(i, event.max_not_arb_idx) < 1.){
+                s = fmt::format("{:.2f}", 1/event.not_odd(i, event.max_not_arb_idx)); 
+            }
+            result += fmt::format(" | {:^{}}", s, width); 
+        } else {
+            int width = std::max(min_width,(int)event.participant_name(0).size());
+            if (event.odd(i, 0) < 1.){
+                s = fmt::format("{:.2f}", 1/event.odd(i, 0)); 
+            }
+            result += fmt::format("{:^{}}", s, width); 
+            for (int j = 1; j < event.participants; j++){
+                int width = std::max(min_width,(int)event.participant_name(j).size());
+                s = " ";
+                if (event.odd(i, j) < 1.){
+                    s = fmt::format("{:.2f}", 1/event.odd(i, j)); 
+                }
+                result += fmt::format(" | {:^{}}", s, width); 
+            }
+        }
+        result += fmt::format(" | {:^7.2f} | {:^8} | {:^8} | {}\n",event.max_nominal_bet(i), AYS_currency(event.store->currency[event.fixtures[i]]), provider_names[event.store->pid[event.fixtures[i]]], event.store->id[event.fixtures[i]]); 
+    }
+    return result;
+}
+
+std::string AYS_fixture_to_string(const AYS_fixture fixture) {
+    bool print_not_odds = false;
+    for (int i = 0; i< (int)fixture.participant_not_odds.size(); i++){
+        print_not_odds |= fixture.participant_not_odds[i] > 1.;
+    }
+    std::string result = fixture.participant_names[0];
+    for (int i = 1; i< (int)fixture.participant_names.size(); i++){
+        result += " | " + fixture.participant_names[i];
+    }
+    for (int i = 0; print_not_odds && i < (int)fixture.participant_names.size(); i++){
+        result += " | NOT "  + fixture.participant_names[i];
+    }
+    char buffer[32];
+    AYS_time_to_string(fixture.start_time, buffer, 32);
+    result += " @ " + std::string(buffer) + " sid: " + std::to_string(fixture.sid) + " line: " + std::to_string(fixture.line)  + " pid "+ std::to_string(fixture.pid) + " ";
+    result += std::to_string(fixture.participant_odds[0]);
+    for (int i = 1; i< (int)fixture.participant_odds.size(); i++){
+        result += " | " + std::to_string(fixture.participant_odds[i]);
+    }
+    for (int i = 0; print_not_odds && i < (int)fixture.participant_not_odds.size(); i++){
+        result += " | " + std::to_string(fixture.participant_not_odds[i]);
+    }
+    return result;
+}
+std::string AYS_event_to_string(const AYS_event event) {
+    std::string result = event.participant_name(0);
+    for (int i = 1; i< event.participants; i++){
+        result += " | " + event.participant_name(i);
+    }
+    char buffer[32];
+    AYS_time_to_string(event.start_time, buffer, 32);
+    result += " @ " + std::string(buffer)+ " sid: " + std::to_string(event.sid) + " btid: " + std::to_string(event.btid) + " line: " + std::to_string(event.line) + " ARB(not): " + std::to_string(event.arb*100) + "% (" +std::to_string(event.not_arb*100) + "%)" + " ROI: " + std::to_string(event.roi) + "%";
+    time_t now = AYS_now();
+    for (int i = 0; i< (int)event.fixtures.size(); i++){
+        if (difftime(event.store->expiry_time[event.fixtures[i]], now) > 0){
+            result += "\n    " + AYS_fixture_to_string(AYS_event_fixture(event, i));
+        }
+    }
+    return result;
+
+}
+
+// the legs of an event, ie. the best fixture of each side that is bet on, in the order of the stakes. Participants
+// without any price have no leg. The vectors are scratch space reused between events
+struct AYS_legs {
+    std::vector<int> max_idx;
+    std::vector<int> max_not_idx;
+    std::vector<float> max_odds;
+    std::vector<float> max_not_odds;
+    std::vector<float> stakes; // of leg l at l
+    float profit;
+    int count;
+    int participant[3];
+    int side[3]; // 0 odd, 1 not
+    int fixture[3]; // in event.fixtures
+    float odds[3]; // inverse odds
+};
+
+// fills legs from the arg-mins AYS_event_arb left in the event, returns the number of legs
+int AYS_event_legs(const AYS_event &event, AYS_legs &legs){
+    AYS_event_best_legs(event, legs.max_idx, legs.max_not_idx);
+    AYS_event_best_odds(event, legs.max_idx.data(), legs.max_not_idx.data(), legs.max_odds, legs.max_not_odds);
+    legs.profit = AYS_event_stakes(event, legs.max_idx, legs.max_not_idx, legs.max_odds, legs.max_not_odds, legs.stakes);
+    legs.count = 0;
+    if (event.arb <= event.not_arb){
+        for (int j = 0; j < event.participants && j < 3; j++){
+            if (legs.max_idx[j] < 0) continue;
+            legs.stakes[legs.count] = legs.stakes[j];
+            legs.participant[legs.count] = j;
+            legs.side[legs.count] = 0;
+            legs.fixture[legs.count] = legs.max_idx[j];
+            legs.odds[legs.count++] = legs.max_odds[j];
+        }
+    } else {
+        int j = event.max_not_arb_idx;
+        int stake = 0;
+        for (int side = 0; side < 2; side++){
+            int i = side ? legs.max_not_idx[j] : legs.max_idx[j];
+            float stake_value = legs.stakes[stake++];
+            if (i < 0) continue;
+            legs.stakes[legs.count] = stake_value;
+            legs.participant[legs.count] = j;
+            legs.side[legs.count] = side;
+            legs.fixture[legs.count] = i;
+            legs.odds[legs.count++] = side ? legs.max_not_odds[j] : legs.max_odds[j];
+        }
+    }
+    return legs.count;
+}
+
+/*
+ * Structured event output for machine consumers. An AYS_event_writer serializes events with their legs (the best
+ * fixture of each side that is bet on), stakes and providers into one reused fmt::memory_buffer, and writes it to a
+ * file descriptor whenever it passes flush_bytes and on AYS_writer_flush, ie. once per batch of events.
+ * JSON Lines, one object per event:
+ *   {"start_time":s,"sid":n,"btid":n,"line":n,"kind":"arb"|"not_arb","arb":x,"not_arb":x,"roi":x,"profit":x,
+ *    "participants":[names],"legs":[{"participant":j,"side":"odd"|"not","odds":decimal odds,"stake":x,"pid":n,
+ *    "provider":name (with provider_names),"id":n,"max_bet":x,"currency":c}]}, numbers that are not finite are null.
+ * Binary, little endian records: uint16 record bytes, uint8 kind (0 arb, 1 not_arb), uint8 legs, int64 start_time,
+ * uint32 sid, uint32 btid, int32 line, float arb, not_arb, roi, profit, then per leg uint8 participant, uint8 side
+ * (0 odd, 1 not), uint32 pid, uint32 id, float decimal odds, stake, max_bet, uint8 currency length and its bytes.
+ * Participants without any price have no leg. The legs come from AYS_event_legs.
+ */
+enum AYS_output_format {
+    AYS_OUTPUT_JSONL,
+    AYS_OUTPUT_BINARY
+};
+
+struct AYS_event_writer {
+    int fd;
+    AYS_output_format format;
+    size_t flush_bytes;
+    const std::vector<std::string> *provider_names; // optional, names the providers in JSON
+    fmt::memory_buffer buffer;
+    AYS_legs legs;
+    uint64_t events;
+    uint64_t bytes; // written to fd
+    AYS_event_writer(int fd, AYS_output_format format = AYS_OUTPUT_JSONL, size_t flush_bytes = 1 << 16) 
+        : fd(fd)
+        , format(format)
+        , flush_bytes(flush_bytes)
+        , provider_names(NULL)
+        , events(0)
+        , bytes(0) { }
+};
+
+// a key or other literal JSON text
+void AYS_json_raw(fmt::memory_buffer &out, fmt::string_view text){
+    out.append(text);
+}
+
+// length of the valid UTF-8 sequence at s[0], 0 if it is not one
+size_t AYS_utf8_length(const unsigned char *s, size_t size){
+    size_t n = s[0] < 0x80 ? 1 : (s[0] >> 5) == 0x6 ? 2 : (s[0] >> 4) == 0xe ? 3 : (s[0] >> 3) == 0x1e ? 4 : 0;
+    if (n == 0 || n > size || (n == 2 && s[0] < 0xc2)) return 0;
+    for (size_t k = 1; k < n; k++){
+        if ((s[k] & 0xc0) != 0x80) return 0;
+    }
+    return n;
+}
+
+// a JSON string, provider spellings that are not valid UTF-8 get U+FFFD for the broken bytes
+void AYS_json_string(fmt::memory_buffer &out, const std::string &value){
+    const unsigned char *s = (const unsigned char *)value.data();
+    size_t size = value.size();
+    out.push_back('"');
+    for (size_t i = 0; i < size; ){
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\'){
+            out.push_back('\\');
+            out.push_back(c);
+            i++;
+        } else if (c < 0x20){
+            fmt::format_to(fmt::appender(out), "\\u{:04x}", (int)c);
+            i++;
+        } else if (c < 0x80){
+            out.push_back(c);
+            i++;
+        } else {
+            size_t n = AYS_utf8_length(s + i, size - i);
+            if (n == 0){
+                AYS_json_raw(out, "\\ufffd");
+                i++;
+            } else {
+                out.append(value.data() + i, value.data() + i + n);
+                i += n;
+            }
+        }
+    }
+    out.push_back('"');
+}
+
+template<size_t N> struct AYS_binary_uint;
+template<> struct AYS_binary_uint<1> { typedef uint8_t type; };
+template<> struct AYS_binary_uint<2> { typedef uint16_t type; };
+template<> struct AYS_binary_uint<4> { typedef uint32_t type; };
+template<> struct AYS_binary_uint<8> { typedef uint64_t type; };
+
+// the binary records are little endian whatever the byte order of the host
+template<typename T>
+void AYS_binary_store(char *out, T value){
+    typename AYS_binary_uint<sizeof(T)>::type bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (size_t k = 0; k < sizeof(T); k++){
+        out[k] = (char)(bits >> (8*k));
+    }
+}
+
+template<typename T>
+T AYS_binary_load(const char *in){
+    typename AYS_binary_uint<sizeof(T)>::type bits = 0;
+    for (size_t k = 0; k < sizeof(T); k++){
+        bits |= (typename AYS_binary_uint<sizeof(T)>::type)(uint8_t)in[k] << (8*k);
+    }
+    T value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+template<typename T>
+void AYS_binary_put(fmt::memory_buffer &out, T value){
+    char bytes[sizeof(T)];
+    AYS_binary_store(bytes, value);
+    out.append(bytes, bytes + sizeof(T));
+}
+
+// writes the buffered output, false (and the output is dropped) if fd fails
+bool AYS_writer_flush(AYS_event_writer &writer){
+    const char *data = writer.buffer.data();
+    size_t size = writer.buffer.size();
+    while (size > 0){
+#ifndef _WIN32
+        ssize_t n = write(writer.fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+#else
+        int n = _write(writer.fd, data, (unsigned)std::min<size_t>(size, 1 << 30));
+#endif
+        if (n <= 0){
+            std::cerr << "could not write events to fd " << writer.fd << std::endl;
+            writer.buffer.clear();
+            return false;
+        }
+        data += n;
+        size -= n;
+        writer.bytes += n;
+    }
+    writer.buffer.clear();
+    return true;
+}
+
+template<typename T>
+void AYS_json_number(fmt::memory_buffer &out, T value){
+    fmt::format_int digits(value);
+    out.append(digits.data(), digits.data() + digits.size());
+}
+
+// JSON has no inf or nan, emptied events and unpriced legs write null
+void AYS_json_number(fmt::memory_buffer &out, float value){
+    if (!std::isfinite(value)){
+        AYS_json_raw(out, "null");
+        return;
+    }
+    fmt::format_to(fmt::appender(out), "{}", value); // shortest round trip
+}
+
+// the fields are written one by one, parsing one long format string per event costs more than the numbers
+void AYS_writer_jsonl(AYS_event_writer &writer, const AYS_event &event){
+    fmt::memory_buffer &out = writer.buffer;
+    const AYS_legs &legs = writer.legs;
+    const AYS_fixture_store &s = *event.store;
+    AYS_json_raw(out, "{\"start_time\":");
+    AYS_json_number(out, (int64_t)event.start_time);
+    AYS_json_raw(out, ",\"sid\":");
+    AYS_json_number(out, event.sid);
+    AYS_json_raw(out, ",\"btid\":");
+    AYS_json_number(out, event.btid);
+    AYS_json_raw(out, ",\"line\":");
+    AYS_json_number(out, event.line);
+    AYS_json_raw(out, event.arb <= event.not_arb ? ",\"kind\":\"arb\",\"arb\":" : ",\"kind\":\"not_arb\",\"arb\":");
+    AYS_json_number(out, event.arb);
+    AYS_json_raw(out, ",\"not_arb\":");
+    AYS_json_number(out, event.not_arb);
+    AYS_json_raw(out, ",\"roi\":");
+    AYS_json_number(out, event.roi);
+    AYS_json_raw(out, ",\"profit\":");
+    AYS_json_number(out, legs.profit);
+    AYS_json_raw(out, ",\"participants\":[");
+    for (int j = 0; j < event.participants; j++){
+        if (j) out.push_back(',');
+        AYS_json_string(out, event.participant_name(j));
+    }
+    AYS_json_raw(out, "],\"legs\":[");
+    for (int l = 0; l < legs.count; l++){
+        uint32_t row = event.fixtures[legs.fixture[l]];
+        AYS_json_raw(out, l ? ",{\"participant\":" : "{\"participant\":");
+        AYS_json_number(out, legs.participant[l]);
+        AYS_json_raw(out, legs.side[l] ? ",\"side\":\"not\",\"odds\":" : ",\"side\":\"odd\",\"odds\":");
+        AYS_json_number(out, 1/legs.odds[l]);
+        AYS_json_raw(out, ",\"stake\":");
+        AYS_json_number(out, legs.stakes[l]);
+        AYS_json_raw(out, ",\"pid\":");
+        AYS_json_number(out, s.pid[row]);
+        if (writer.provider_names && s.pid[row] < writer.provider_names->size()){
+            AYS_json_raw(out, ",\"provider\":");
+            AYS_json_string(out, (*writer.provider_names)[s.pid[row]]);
+        }
+        AYS_json_raw(out, ",\"id\":");
+        AYS_json_number(out, s.id[row]);
+        AYS_json_raw(out, ",\"max_bet\":");
+        AYS_json_number(out, s.max_nominal_bet[row]);
+        AYS_json_raw(out, ",\"currency\":");
+        AYS_json_string(out, AYS_currency(s.currency[row]));
+        out.push_back('}');
+    }
+    AYS_json_raw(out, "]}\n");
+}
+
+void AYS_writer_binary(AYS_event_writer &writer, const AYS_event &event){
+    fmt::memory_buffer &out = writer.buffer;
+    const AYS_legs &legs = writer.legs;
+    const AYS_fixture_store &s = *event.store;
+    size_t start = out.size();
+    AYS_binary_put<uint16_t>(out, 0); // patched below
+    AYS_binary_put<uint8_t>(out, event.arb <= event.not_arb ? 0 : 1);
+    AYS_binary_put<uint8_t>(out, legs.count);
+    AYS_binary_put<int64_t>(out, event.start_time);
+    AYS_binary_put<uint32_t>(out, event.sid);
+    AYS_binary_put<uint32_t>(out, event.btid);
+    AYS_binary_put<int32_t>(out, event.line);
+    AYS_binary_put<float>(out, event.arb);
+    AYS_binary_put<float>(out, event.not_arb);
+    AYS_binary_put<float>(out, event.roi);
+    AYS_binary_put<float>(out, legs.profit);
+    for (int l = 0; l < legs.count; l++){
+        uint32_t row = event.fixtures[legs.fixture[l]];
+        const std::string &currency = AYS_currency(s.currency[row]);
+        uint8_t currency_size = std::min<size_t>(currency.size(), 255);
+        AYS_binary_put<uint8_t>(out, legs.participant[l]);
+        AYS_binary_put<uint8_t>(out, legs.side[l]);
+        AYS_binary_put<uint32_t>(out, s.pid[row]);
+        AYS_binary_put<uint32_t>(out, s.id[row]);
+        AYS_binary_put<float>(out, 1/legs.odds[l]);
+        AYS_binary_put<float>(out, legs.stakes[l]);
+        AYS_binary_put<float>(out, s.max_nominal_bet[row]);
+        AYS_binary_put<uint8_t>(out, currency_size);
+        out.append(currency.data(), currency.data() + currency_size);
+    }
+    AYS_binary_store<uint16_t>(out.data() + start, out.size() - start);
+}
+
+// appends the event, writes the buffer when it passed flush_bytes
+bool AYS_writer_append(AYS_event_writer &writer, const AYS_event &event){
+    AYS_event_legs(event, writer.legs);
+    if (writer.format == AYS_OUTPUT_BINARY){
+        AYS_writer_binary(writer, event);
+    } else {
+        AYS_writer_jsonl(writer, event);
+    }
+    writer.events++;
+    if (writer.buffer.size() >= writer.flush_bytes){
+        return AYS_writer_flush(writer);
+    }
+    return true;
+}
+
+// writes the events with roi >= min_roi as one batch
+bool AYS_writer_write(AYS_event_writer &writer, const std::vector<AYS_event> &events, float min_roi = 0){
+    bool ok = true;
+    for (auto& event : events){
+        if (event.roi >= min_roi){
+            ok = AYS_writer_append(writer, event) && ok;
+        }
+    }
+    return AYS_writer_flush(writer) && ok;
+}
+bool AYS_roi_compare(const AYS_event &e1, const AYS_event &e2){
+    return e1.roi < e2.roi;
+}
+bool AYS_arb_compare(const AYS_event &e1, const AYS_event &e2){
+    return std::min(e1.arb,e1.not_arb) > std::min(e2.arb,e2.not_arb);
+}
+bool AYS_line_compare(const AYS_fixture &f1, const AYS_fixture &f2){
+    return f1.line < f2.line;
+}
+bool AYS_start_time_compare(const AYS_fixture &f1, const AYS_fixture &f2){
+    return difftime(f1.start_time, f2.start_time) < 0;
+}
+bool AYS_participant_number_compare(const AYS_fixture &f1, const AYS_fixture &f2){
+    return f1.participant_names.size() < f2.participant_names.size();
+}
+
+bool AYS_btid_compare(const AYS_fixture &f1, const AYS_fixture &f2){
+    return f1.btid < f2.btid;
+}
+
+bool AYS_sid_compare(const AYS_fixture &f1, const AYS_fixture &f2){
+    return f1.sid < f2.sid;
+}
+
+#ifdef AYS_LEMON
+int min_weight_matching_lemon(const int pairs, const std::vector<std::vector<int>> &weightMatrix, std::vector<int> &solution){
+    using Graph = lemon::SmartDigraph;
+    using Node = Graph::Node;
+    using Arc = Graph::Arc;
+    using MCF = lemon::NetworkSimplex<Graph, int32_t, int32_t>;
+
+    int nodeNum = pairs*2+2; // worker and task in each pair + source and sink
+    int arcNum = pairs*(pairs+2); // all to all between workers and tasks 
                                   // + one to all source to workers
                                   // + all to one tasks to sink 
     
@@ -357,184 +2454,2568 @@ int min_weight_matching(const int pairs, const std::vector<std::vector<int>> &we
     for(int i = 0; i < nodeNum; i++){
         nodes[i] = g.addNode();
     }
-    int sourceIDX = 0;
-    int sinkIDX = nodeNum-1;
-    Node sourceNode = nodes[sourceIDX];
-    Node sinkNode = nodes[sinkIDX];
-    Arc arc;
-    Node toNode;
-    Node fromNode;
-    int arcIDX = 0; 
-    for (int to = 1; to < nodeNum-1; to+=2){ // source to workers
-        toNode = nodes[to];
-        arc = g.addArc(sourceNode, toNode);
-        capacities[arc] = 1;
-        weights[arc] = 1;
-        //std::cout << "edge: " << sourceIDX << "->" << to << " @ " << weights[arc] << std::endl ;
-        arcs[arcIDX++] = arc;
+    int sourceIDX = 0;
+    int sinkIDX = nodeNum-1;
+    Node sourceNode = nodes[sourceIDX];
+    Node sinkNode = nodes[sinkIDX];
+    Arc arc;
+    Node toNode;
+    Node fromNode;
+    int arcIDX = 0; 
+    for (int to = 1; to < nodeNum-1; to+=2){ // source to workers
+        toNode = nodes[to];
+        arc = g.addArc(sourceNode, toNode);
+        capacities[arc] = 1;
+        weights[arc] = 1;
+        //std::cout << "edge: " << sourceIDX << "->" << to << " @ " << weights[arc] << std::endl ;
+        arcs[arcIDX++] = arc;
+    }
+    for (int from = 2; from < nodeNum-1; from+=2){ // tasks to sink
+        fromNode = nodes[from];
+        arc = g.addArc(fromNode, sinkNode);
+        capacities[arc] = 1;
+        weights[arc] = 1;
+        //std::cout << "edge: " << from << "->" << sinkIDX << " @ " << weights[arc] << std::endl ;
+        arcs[arcIDX++] = arc;
+    }
+    for (int worker = 0; worker < pairs; worker++ ){ // workers to tasks
+        for (int task = 0; task < pairs; task++ ){
+            int from = worker*2+1;
+            int to = task*2+2;
+            toNode = nodes[to];
+            fromNode = nodes[from];
+            arc = g.addArc(fromNode, toNode);
+            capacities[arc] = 1;
+            weights[arc] = weightMatrix[worker][task];
+            //std::cout << "edge: " << from << "->" << to << " @ " << weights[arc] << std::endl ;
+            arcs[arcIDX++] = arc;
+        }
+    }
+
+    Graph::ArcMap<int32_t> flows(g);
+    MCF solver(g);
+    MCF::ProblemType status = solver.upperMap(capacities).costMap(weights).stSupply(sourceNode, sinkNode, pairs).run();
+    switch (status) 
+    {
+        case MCF::INFEASIBLE:
+            std::cerr << "insufficient flow" << std::endl;
+            return 1;
+        case MCF::OPTIMAL:
+            solver.flowMap(flows);
+            for (int worker = 0; worker < pairs; worker++ ){ // workers to tasks
+                for (int task = 0; task < pairs; task++ ){
+                    arc = arcs[pairs*2 + worker*pairs + task];
+                    if(flows[arc] != 0){
+                        solution[worker] = task;
+                    }
+                }
+            }
+            break;
+        case MCF::UNBOUNDED:
+            std::cerr << "infinite flow" << std::endl;
+            return 2;
+        default:
+            break;
+    }
+    return 0;
+}
+#endif
+
+/*
+ * Assignment solvers for the participant matching.
+ * w is a row-major pairs*pairs cost matrix, sol[worker] = task. Returns the total cost.
+ * Small sizes enumerate every permutation, larger ones run the O(n^3) Hungarian algorithm on potentials.
+ * Neither allocates a graph. When the optimum is unique that is the assignment min_weight_matching_lemon finds.
+ * Ties are common with integer distances, and there the optimum LEMON returns depends on its pivots, so a tied
+ * matrix is handed to AYS_assign_simplex, which pivots like LEMON on the same network. Optima costing tie_limit or
+ * more are returned as found, similarity_sort rejects every one of those anyway.
+ */
+
+/*
+ * The network simplex of LEMON's NetworkSimplex (1.3, default block search pivot rule and arc mixing) on the
+ * network min_weight_matching_lemon builds: source 0, worker i at 2i+1, task j at 2j+2, sink 2n+1, arcs source to
+ * workers, tasks to sink, then workers to tasks row by row, all of capacity 1. LEMON numbers the nodes and arcs
+ * of a SmartDigraph from the last one added, mixes the arcs with a stride, starts from a tree of artificial arcs
+ * to an extra root and takes the last blocking arc of the cycle as leaving arc. Following the same entering and
+ * leaving arcs gives the same flow, so the same optimum among tied ones. The tree is rebuilt after each pivot
+ * instead of updated in place, which finds the same parents, subtree sizes and potentials.
+ */
+#define AYS_SIMPLEX_INTS(n) (5*((n)*((n)+2) + 2*(n)+2) + 8*(2*(n)+3))
+#define AYS_SIMPLEX_LONGS(n) (3*((n)*((n)+2) + 2*(n)+2) + 2*(n)+3)
+
+// ints and longs hold AYS_SIMPLEX_INTS(n) and AYS_SIMPLEX_LONGS(n) values
+int AYS_assign_simplex(const int n, const int *w, int *sol, int *ints, int64_t *longs){
+    AYS_STAT_ADD(matching_ties, 1);
+    const int nodes = 2*n+2, arcs = n*(n+2), root = nodes, all_arcs = arcs+nodes;
+    const int64_t inf = std::numeric_limits<int32_t>::max(), art_cost = std::numeric_limits<int32_t>::max()/2+1;
+    const int lower = 1, tree = 0, upper = -1; // arc states, LEMON's STATE_LOWER, STATE_TREE, STATE_UPPER
+    int *source = ints, *target = source + all_arcs, *state = target + all_arcs, *arc_id = state + all_arcs;
+    int *in_tree = arc_id + all_arcs;
+    int *parent = in_tree + all_arcs, *pred = parent + nodes+1, *dir = pred + nodes+1, *size = dir + nodes+1;
+    int *order = size + nodes+1, *first_adj = order + nodes+1, *adj = first_adj + nodes+1; // adj holds 2 per tree arc
+    int64_t *cost = longs, *cap = cost + all_arcs, *flow = cap + all_arcs, *pi = flow + all_arcs;
+    std::fill(state, state + arcs, lower);
+    std::fill(cap, cap + arcs, 1);
+    std::fill(in_tree, in_tree + arcs, 0);
+    std::fill(flow, flow + arcs, 0);
+    // graph arc a in insertion order, from and to as graph nodes, node k of the graph is node nodes-1-k of LEMON
+    const int skip = std::max(arcs/nodes, 3);
+    for (int a = arcs-1, i = 0, j = 0; a >= 0; a--){
+        int from, to;
+        int64_t c = 1;
+        if (a < n){
+            from = 0;
+            to = 2*a+1;
+        } else if (a < 2*n){
+            from = 2*(a-n)+2;
+            to = nodes-1;
+        } else {
+            from = 2*((a-2*n)/n)+1;
+            to = 2*((a-2*n)%n)+2;
+            c = w[a-2*n];
+        }
+        arc_id[a] = i;
+        source[i] = nodes-1-from;
+        target[i] = nodes-1-to;
+        cost[i] = c;
+        if ((i += skip) >= arcs) i = ++j;
+    }
+    // artificial arcs, the source supplies n and the sink takes them
+    for (int u = 0, e = arcs; u < nodes; u++, e++){
+        int64_t supply = u == nodes-1 ? n : u == 0 ? -n : 0;
+        state[e] = tree;
+        in_tree[e] = 1;
+        cap[e] = inf;
+        source[e] = supply >= 0 ? u : root;
+        target[e] = supply >= 0 ? root : u;
+        flow[e] = supply >= 0 ? supply : -supply;
+        cost[e] = supply >= 0 ? 0 : art_cost;
+    }
+    const int block = std::max((int)std::sqrt((double)arcs), 10);
+    int next_arc = 0;
+    while (true){
+        // parents, subtree sizes and potentials of the tree hanging from the root
+        std::fill(first_adj, first_adj + nodes+1, 0);
+        for (int e = 0; e < all_arcs; e++){
+            if (!in_tree[e]) continue;
+            first_adj[source[e]]++;
+            first_adj[target[e]]++;
+        }
+        for (int x = 0, sum = 0; x <= nodes; x++){ // counts to ends, the fill below moves them to the starts
+            sum += first_adj[x];
+            first_adj[x] = sum;
+        }
+        for (int e = all_arcs-1; e >= 0; e--){
+            if (!in_tree[e]) continue;
+            adj[--first_adj[source[e]]] = e;
+            adj[--first_adj[target[e]]] = e;
+        }
+        int reached = 1;
+        order[0] = root;
+        parent[root] = -1;
+        pi[root] = 0;
+        for (int k = 0; k < reached; k++){
+            int u = order[k];
+            int end = u == nodes ? 2*nodes : first_adj[u+1];
+            for (int a = first_adj[u]; a < end; a++){
+                int e = adj[a];
+                int v = source[e] == u ? target[e] : source[e];
+                if (v == parent[u]) continue;
+                parent[v] = u;
+                pred[v] = e;
+                dir[v] = source[e] == v ? 1 : -1; // LEMON's DIR_UP, DIR_DOWN
+                pi[v] = dir[v] == 1 ? pi[u] - cost[e] : pi[u] + cost[e];
+                order[reached++] = v;
+            }
+        }
+        for (int k = nodes; k >= 0; k--){
+            size[order[k]] = 1;
+        }
+        for (int k = nodes; k > 0; k--){
+            size[parent[order[k]]] += size[order[k]];
+        }
+        // block search for the entering arc
+        int64_t best = 0;
+        int in_arc = -1, cnt = block, e = next_arc;
+        for (int scanned = 0; scanned < arcs; scanned++, e = e+1 == arcs ? 0 : e+1){
+            int64_t c = state[e]*(cost[e] + pi[source[e]] - pi[target[e]]);
+            if (c < best){
+                best = c;
+                in_arc = e;
+            }
+            if (--cnt == 0){
+                if (best < 0) break;
+                cnt = block;
+            }
+        }
+        if (in_arc < 0) break;
+        next_arc = e;
+        // the join node and the leaving arc, the last blocking one along the cycle
+        int u = source[in_arc], v = target[in_arc];
+        while (u != v){
+            if (size[u] < size[v]) u = parent[u];
+            else v = parent[v];
+        }
+        int join = u;
+        int first = state[in_arc] == lower ? source[in_arc] : target[in_arc];
+        int second = state[in_arc] == lower ? target[in_arc] : source[in_arc];
+        int64_t delta = cap[in_arc];
+        int u_out = -1;
+        for (int x = first; x != join; x = parent[x]){
+            int64_t d = dir[x] == -1 ? (cap[pred[x]] >= inf ? inf : cap[pred[x]] - flow[pred[x]]) : flow[pred[x]];
+            if (d < delta){
+                delta = d;
+                u_out = x;
+            }
+        }
+        for (int x = second; x != join; x = parent[x]){
+            int64_t d = dir[x] == 1 ? (cap[pred[x]] >= inf ? inf : cap[pred[x]] - flow[pred[x]]) : flow[pred[x]];
+            if (d <= delta){
+                delta = d;
+                u_out = x;
+            }
+        }
+        if (delta > 0){
+            int64_t val = state[in_arc]*delta;
+            flow[in_arc] += val;
+            for (int x = source[in_arc]; x != join; x = parent[x]){
+                flow[pred[x]] -= dir[x]*val;
+            }
+            for (int x = target[in_arc]; x != join; x = parent[x]){
+                flow[pred[x]] += dir[x]*val;
+            }
+        }
+        if (u_out >= 0){
+            int out_arc = pred[u_out];
+            state[in_arc] = tree;
+            in_tree[in_arc] = 1;
+            state[out_arc] = flow[out_arc] == 0 ? lower : upper;
+            in_tree[out_arc] = 0;
+        } else {
+            state[in_arc] = -state[in_arc];
+        }
+    }
+    int total = 0;
+    for (int worker = 0; worker < n; worker++){
+        for (int task = 0; task < n; task++){
+            if (flow[arc_id[2*n + worker*n + task]] != 0){
+                sol[worker] = task;
+            }
+        }
+        total += w[worker*n + sol[worker]];
+    }
+    return total;
+}
+
+int AYS_assign_simplex(const int n, const int *w, int *sol){
+    std::vector<int> ints(AYS_SIMPLEX_INTS(n));
+    std::vector<int64_t> longs(AYS_SIMPLEX_LONGS(n));
+    return AYS_assign_simplex(n, w, sol, ints.data(), longs.data());
+}
+
+template<int N>
+int AYS_assign_enumerate(const int *w, int *sol, int tie_limit){
+    int perm[N];
+    for (int i = 0; i < N; i++){
+        perm[i] = i;
+    }
+    int best = std::numeric_limits<int>::max();
+    bool tied = false;
+    do {
+        int cost = 0;
+        for (int i = 0; i < N; i++){
+            cost += w[i*N + perm[i]];
+        }
+        if (cost < best){
+            best = cost;
+            tied = false;
+            std::copy(perm, perm+N, sol);
+        } else if (cost == best){
+            tied = true;
+        }
+    } while (std::next_permutation(perm, perm+N));
+    if (!tied || best >= tie_limit) return best;
+    int ints[AYS_SIMPLEX_INTS(N)];
+    int64_t longs[AYS_SIMPLEX_LONGS(N)];
+    return AYS_assign_simplex(N, w, sol, ints, longs);
+}
+
+int AYS_assign_hungarian(const int n, const int *w, int *sol, int tie_limit){
+    const int inf = std::numeric_limits<int>::max();
+    // 1-indexed potentials u (workers), v (tasks), p[task] = worker, 0 is the virtual start
+    std::vector<int> u(n+1, 0), v(n+1, 0), p(n+1, 0), way(n+1, 0), minv(n+1);
+    std::vector<char> used(n+1);
+    for (int i = 1; i <= n; i++){
+        p[0] = i;
+        int j0 = 0;
+        std::fill(minv.begin(), minv.end(), inf);
+        std::fill(used.begin(), used.end(), 0);
+        do {
+            used[j0] = 1;
+            int i0 = p[j0], delta = inf, j1 = 0;
+            for (int j = 1; j <= n; j++){
+                if (used[j]) continue;
+                int cur = w[(i0-1)*n + j-1] - u[i0] - v[j];
+                if (cur < minv[j]){
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta){
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            for (int j = 0; j <= n; j++){
+                if (used[j]){
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+        do {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0);
+    }
+    int cost = 0;
+    for (int j = 1; j <= n; j++){
+        sol[p[j]-1] = j-1;
+        cost += w[(p[j]-1)*n + j-1];
+    }
+    if (cost >= tie_limit) return cost;
+    // every optimum is tight on the final potentials, another one exists if worker i can take the task of worker
+    // k at zero reduced cost along a cycle of workers
+    std::vector<char> color(n, 0); // 0 unvisited, 1 on the path, 2 done
+    for (int start = 0; start < n; start++){
+        if (color[start]) continue;
+        std::vector<std::pair<int, int>> path(1, std::make_pair(start, 0));
+        color[start] = 1;
+        while (!path.empty()){
+            int i = path.back().first, &k = path.back().second;
+            if (k == n){
+                color[i] = 2;
+                path.pop_back();
+                continue;
+            }
+            int next = k++;
+            if (next == i || w[i*n + sol[next]] - u[i+1] - v[sol[next]+1] != 0) continue;
+            if (color[next] == 1) return AYS_assign_simplex(n, w, sol);
+            if (color[next] == 0){
+                color[next] = 1;
+                path.push_back(std::make_pair(next, 0));
+            }
+        }
+    }
+    return cost;
+}
+
+int AYS_assign(const int pairs, const int *w, int *sol, int tie_limit = std::numeric_limits<int>::max()){
+    switch (pairs){
+        case 0: return 0;
+        case 1: return AYS_assign_enumerate<1>(w, sol, tie_limit);
+        case 2: return AYS_assign_enumerate<2>(w, sol, tie_limit);
+        case 3: return AYS_assign_enumerate<3>(w, sol, tie_limit);
+        case 4: return AYS_assign_enumerate<4>(w, sol, tie_limit);
+        default: return AYS_assign_hungarian(pairs, w, sol, tie_limit);
+    }
+}
+
+int min_weight_matching(const int pairs, const std::vector<std::vector<int>> &weightMatrix, std::vector<int> &solution){
+    std::vector<int> w(pairs*pairs);
+    for (int worker = 0; worker < pairs; worker++ ){
+        std::copy(weightMatrix[worker].begin(), weightMatrix[worker].begin()+pairs, w.begin()+worker*pairs);
+    }
+    solution.resize(pairs);
+    AYS_assign(pairs, w.data(), solution.data());
+    return 0;
+}
+
+
+/*
+ * Bounded LRU cache of similarity_sort results keyed on the ordered name ids of both sides.
+ * Providers resend the same name tuples scan after scan, a hit skips the distance matrix and the matching.
+ */
+struct AYS_match_result {
+    float sim;
+    std::vector<int> solution;
+};
+
+struct AYS_match_cache {
+    typedef std::pair<std::string, AYS_match_result> entry;
+    size_t capacity;
+    std::list<entry> lru; // most recently used first
+    std::unordered_map<std::string, std::list<entry>::iterator> map;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    std::mutex lock; // taken by similarity_sort so parallel scans can share the cache
+    AYS_match_cache(size_t capacity = 1<<16) 
+        : capacity(capacity)
+        , hits(0)
+        , misses(0)
+        , evictions(0) { }
+};
+
+// the name ids of both lists back to back, the lists have the same length
+std::string AYS_match_cache_key(const AYS_name_id *a1, const AYS_name_id *a2, int pairs){
+    std::string key(2*pairs*sizeof(AYS_name_id), '\0');
+    memcpy(&key[0], a1, pairs*sizeof(AYS_name_id));
+    memcpy(&key[pairs*sizeof(AYS_name_id)], a2, pairs*sizeof(AYS_name_id));
+    return key;
+}
+
+const AYS_match_result *AYS_match_cache_get(AYS_match_cache &cache, const std::string &key){
+    auto it = cache.map.find(key);
+    if (it == cache.map.end()){
+        cache.misses++;
+        return NULL;
+    }
+    cache.hits++;
+    cache.lru.splice(cache.lru.begin(), cache.lru, it->second);
+    return &it->second->second;
+}
+
+// two workers can miss the same key, the second put updates the entry of the first
+void AYS_match_cache_put(AYS_match_cache &cache, const std::string &key, float sim, const std::vector<int> &solution){
+    if (cache.capacity == 0) return;
+    auto it = cache.map.find(key);
+    if (it != cache.map.end()){
+        it->second->second = AYS_match_result{sim, solution};
+        cache.lru.splice(cache.lru.begin(), cache.lru, it->second);
+        return;
+    }
+    while (cache.map.size() >= cache.capacity){
+        cache.map.erase(cache.lru.back().first);
+        cache.lru.pop_back();
+        cache.evictions++;
+    }
+    cache.lru.emplace_front(key, AYS_match_result{sim, solution});
+    cache.map[key] = cache.lru.begin();
+}
+
+void AYS_match_cache_clear(AYS_match_cache &cache){
+    cache.lru.clear();
+    cache.map.clear();
+    cache.hits = cache.misses = cache.evictions = 0;
+}
+
+std::string AYS_match_cache_stats(const AYS_match_cache &cache){
+    return fmt::format("match cache size: {}/{} hits: {} misses: {} evictions: {}", 
+                       cache.map.size(), cache.capacity, cache.hits, cache.misses, cache.evictions);
+}
+
+/*
+ * Name distances, on the folded names of the intern table.
+ * Distances only matter up to the 0.25 cutoff, so the kernel takes the largest useful distance max_d and
+ * returns max_d+1 for anything further apart: names whose lengths differ by more than max_d never reach the kernel,
+ * names up to 64 bytes run Myers' bit-parallel algorithm (one word op per text byte covering the whole column) and
+ * stop as soon as the last row cannot come back below max_d, longer names run a DP restricted to the diagonal
+ * band |i-j| <= max_d that stops once a whole row is above max_d.
+ */
+int AYS_levenshtein_myers(const std::string &a, const std::string &b, int max_d){ // 0 < a.size() <= 64
+    uint64_t peq[256] = {0};
+    int m = a.size();
+    int n = b.size();
+    for (int i = 0; i < m; i++){
+        peq[(unsigned char)a[i]] |= 1ull << i;
+    }
+    uint64_t last = 1ull << (m-1);
+    uint64_t pv = m == 64 ? ~0ull : (1ull << m)-1;
+    uint64_t mv = 0;
+    int score = m;
+    for (int j = 0; j < n; j++){
+        uint64_t eq = peq[(unsigned char)b[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & last) score++;
+        else if (mh & last) score--;
+        if (score - (n-j-1) > max_d) return max_d+1; // every remaining byte lowers it by at most one
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return std::min(score, max_d+1);
+}
+
+int AYS_levenshtein_banded(const std::string &a, const std::string &b, int max_d){
+    int m = a.size();
+    int n = b.size();
+    int far = max_d+1;
+    std::vector<int> prev(n+1, far);
+    std::vector<int> cur(n+1, far);
+    for (int j = 0; j <= std::min(n, max_d); j++){
+        prev[j] = j;
+    }
+    for (int i = 1; i <= m; i++){
+        int lo = std::max(1, i-max_d);
+        int hi = std::min(n, i+max_d);
+        cur[lo-1] = lo == 1 && i <= max_d ? i : far;
+        int row_min = cur[lo-1];
+        for (int j = lo; j <= hi; j++){
+            int d = prev[j-1] + (a[i-1] != b[j-1]);
+            d = std::min(d, prev[j]+1);
+            d = std::min(d, cur[j-1]+1);
+            cur[j] = std::min(d, far);
+            row_min = std::min(row_min, cur[j]);
+        }
+        if (hi < n) cur[hi+1] = far;
+        if (row_min > max_d) return far;
+        std::swap(prev, cur);
+    }
+    return prev[n];
+}
+
+// the Levenshtein distance of a and b if it is at most max_d, max_d+1 otherwise
+int AYS_levenshtein_bounded(const std::string &a, const std::string &b, int max_d){
+    const std::string &s = a.size() <= b.size() ? a : b; // the shorter one is the pattern
+    const std::string &t = a.size() <= b.size() ? b : a;
+    if ((int)(t.size()-s.size()) > max_d) return max_d+1;
+    if (s.size() == 0) return t.size();
+    if (s.size() <= 64) return AYS_levenshtein_myers(s, t, max_d);
+    return AYS_levenshtein_banded(s, t, max_d);
+}
+
+// the largest distance that keeps a pair within the 0.25 cutoff of similarity_sort
+int AYS_name_max_distance(const AYS_participant &a, const AYS_participant &b){
+    return ((a.size() + b.size()) >> 1)/4;
+}
+
+#define AYS_FAR_DISTANCE (1 << 16) // any assignment using a pair beyond the cutoff costs more than one that does not
+
+// the distance matrix of two name lists in one call, pairs beyond the cutoff get AYS_FAR_DISTANCE
+void AYS_name_distances(const AYS_name_id *a1, const AYS_name_id *a2, int pairs, int *matrix){
+    const AYS_intern_table &names = AYS_names();
+    const AYS_interned *small[8];
+    std::vector<const AYS_interned*> large;
+    const AYS_interned **e2 = small;
+    if (pairs > 8){
+        large.resize(pairs);
+        e2 = large.data();
+    }
+    for (int j = 0; j < pairs; j++){
+        e2[j] = &AYS_interned_get(names, a2[j]);
+    }
+    for (int i = 0; i < pairs; i++){
+        const AYS_interned &n1 = AYS_interned_get(names, a1[i]);
+        for (int j = 0; j < pairs; j++){
+            const AYS_interned &n2 = *e2[j];
+            if (a1[i] == a2[j] || (n1.hash == n2.hash && n1.folded == n2.folded)){
+                matrix[i*pairs + j] = 0;
+                continue;
+            }
+            int max_d = AYS_name_max_distance(n1.folded, n2.folded);
+            int d = AYS_levenshtein_bounded(n1.folded, n2.folded, max_d);
+            matrix[i*pairs + j] = d > max_d ? AYS_FAR_DISTANCE : d;
+        }
+    }
+}
+
+float similarity_sort(const AYS_name_id *a1, const AYS_name_id *a2, int pairs, std::vector<int> *solution, AYS_match_cache *cache = NULL){
+    AYS_STAT_ADD(similarity_calls, 1);
+    std::string key;
+    if (cache){
+        key = AYS_match_cache_key(a1, a2, pairs);
+        std::lock_guard<std::mutex> guard(cache->lock);
+        const AYS_match_result *hit = AYS_match_cache_get(*cache, key);
+        if (hit){
+            AYS_STAT_ADD(similarity_cache_hits, 1);
+            *solution = hit->solution;
+            return hit->sim;
+        }
+    }
+    AYS_STAT_CLOCK(start);
+    (*solution).resize(pairs);
+    int small_matrix[16];
+    std::vector<int> large_matrix;
+    int *sim_matrix = small_matrix;
+    if (pairs > 4){
+        large_matrix.resize(pairs*pairs);
+        sim_matrix = large_matrix.data();
+    }
+    AYS_name_distances(a1, a2, pairs, sim_matrix);
+    AYS_assign(pairs, sim_matrix, (*solution).data(), AYS_FAR_DISTANCE); // an optimum this far pairs a name past the cutoff
+    AYS_STAT_ADD(matching_solves, 1);
+    float max = 0;
+    for (int i = 0; i<pairs; i++){
+        float x = (float)sim_matrix[i*pairs + (*solution)[i]]/((AYS_name_entry(a1[i]).folded.size() + AYS_name_entry(a2[(*solution)[i]]).folded.size()) >>1);
+        if (x>max){
+            max = x;
+        }
+    }
+    AYS_STAT_LATENCY(start);
+    if (cache){
+        std::lock_guard<std::mutex> guard(cache->lock);
+        AYS_match_cache_put(*cache, key, max, *solution);
+    }
+    return max; 
+}
+
+float similarity_sort(const std::vector<std::string> &a1,const std::vector<std::string> &a2, std::vector<int> *solution, AYS_match_cache *cache = NULL){
+    if (a1.size() != a2.size()){
+        std::cerr << "different lengths a1:" <<a1.size() << " != a2:" << a2.size() << std::endl;
+        return 1.f;
+    }
+    std::vector<AYS_name_id> ids1, ids2;
+    for (int i = 0; i < (int)a1.size(); i++){
+        ids1.push_back(AYS_intern(AYS_names(), a1[i]));
+        ids2.push_back(AYS_intern(AYS_names(), a2[i]));
+    }
+    return similarity_sort(ids1.data(), ids2.data(), a1.size(), solution, cache);
+}
+
+bool AYS_fixture_filter(const AYS_fixture &fixture, time_t now, bool includeLive){
+    if (difftime(fixture.expiry_time, now) <= 0){
+        AYS_STAT_ADD(fixtures_expired, 1);
+        return false;
+    }
+    if (!includeLive && difftime(fixture.start_time, now) <= 0){
+        AYS_STAT_ADD(fixtures_live, 1);
+        return false;
+    }
+    if (fixture.participant_names.size() > 3){
+        AYS_STAT_ADD(fixtures_oversized, 1);
+        return false;
+    }
+    return true;
+}
+
+bool AYS_store_filter(const AYS_fixture_store &store, uint32_t row, time_t now, bool includeLive){
+    if (difftime(store.expiry_time[row], now) <= 0){
+        AYS_STAT_ADD(fixtures_expired, 1);
+        return false;
+    }
+    if (!includeLive && difftime(store.start_time[row], now) <= 0){
+        AYS_STAT_ADD(fixtures_live, 1);
+        return false;
+    }
+    if (AYS_store_participants(store, row) > 3){
+        AYS_STAT_ADD(fixtures_oversized, 1);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Grouping of fixtures that can belong to the same event, ie. same start_time, btid, sid, participant count and line.
+ * The composite key is built once per fixture and the fixtures are bucketed in one hashing pass followed by a
+ * counting scatter. Buckets are index ranges into order, fixtures keep their input order within a bucket and the
+ * buckets are ordered by (line, participants, sid, btid, start_time).
+ */
+typedef std::tuple<time_t, AYS_bet_type_id, AYS_sport_id, size_t, int> AYS_bucket_key;
+
+struct AYS_bucket_key_hash {
+    size_t operator()(const AYS_bucket_key &k) const {
+        uint64_t h = (uint64_t)std::get<0>(k);
+        h = h*0x9E3779B97F4A7C15ull ^ std::get<1>(k);
+        h = h*0x9E3779B97F4A7C15ull ^ std::get<2>(k);
+        h = h*0x9E3779B97F4A7C15ull ^ std::get<3>(k);
+        h = h*0x9E3779B97F4A7C15ull ^ (uint32_t)std::get<4>(k);
+        return h ^ (h >> 29);
+    }
+};
+
+struct AYS_bucket {
+    AYS_bucket_key key;
+    uint32_t begin; // [begin, end) into the order vector
+    uint32_t end;
+};
+
+AYS_bucket_key AYS_fixture_bucket_key(const AYS_fixture &f){
+    return AYS_bucket_key(f.start_time, f.btid, f.sid, f.participant_names.size(), f.line);
+}
+
+AYS_bucket_key AYS_store_bucket_key(const AYS_fixture_store &store, uint32_t row){
+    return AYS_bucket_key(store.start_time[row], store.btid[row], store.sid[row], AYS_store_participants(store, row), store.line[row]);
+}
+
+AYS_bucket_key AYS_event_bucket_key(const AYS_event &e){
+    return AYS_bucket_key(e.start_time, e.btid, e.sid, e.participants, e.line);
+}
+
+bool AYS_bucket_compare(const AYS_bucket &b1, const AYS_bucket &b2){
+    return std::make_tuple(std::get<4>(b1.key), std::get<3>(b1.key), std::get<2>(b1.key), std::get<1>(b1.key), std::get<0>(b1.key)) 
+         < std::make_tuple(std::get<4>(b2.key), std::get<3>(b2.key), std::get<2>(b2.key), std::get<1>(b2.key), std::get<0>(b2.key));
+}
+
+typedef std::unordered_map<AYS_bucket_key, uint32_t, AYS_bucket_key_hash, std::equal_to<AYS_bucket_key>, 
+                           AYS_arena_allocator<std::pair<const AYS_bucket_key, uint32_t>>> AYS_bucket_lookup;
+
+// bucket the rows idx of the store, order receives the rows grouped by bucket, the temporaries come from the
+// allocator of order
+void AYS_bucket_fixtures(const AYS_fixture_store &store, 
+                         const AYS_arena_vector<uint32_t> &idx, 
+                         AYS_arena_vector<uint32_t> &order, 
+                         AYS_arena_vector<AYS_bucket> &buckets) {
+    AYS_arena_allocator<uint32_t> alloc = order.get_allocator();
+    buckets.clear();
+    order.resize(idx.size());
+    AYS_bucket_lookup lookup(16, AYS_bucket_key_hash(), std::equal_to<AYS_bucket_key>(), alloc);
+    AYS_arena_vector<uint32_t> bucket_of(idx.size(), 0, alloc);
+    for (int i = 0; i < (int)idx.size(); i++){
+        AYS_bucket_key key = AYS_store_bucket_key(store, idx[i]);
+        auto it = lookup.find(key);
+        if (it == lookup.end()){
+            it = lookup.emplace(key, (uint32_t)buckets.size()).first;
+            buckets.push_back(AYS_bucket{key, 0, 0});
+        }
+        bucket_of[i] = it->second;
+        buckets[it->second].end++; // count for now
+    }
+    AYS_arena_vector<uint32_t> sorted(buckets.size(), 0, alloc);
+    for (int b = 0; b < (int)buckets.size(); b++){
+        sorted[b] = b;
+    }
+    std::sort(sorted.begin(), sorted.end(), [&](uint32_t b1, uint32_t b2){ return AYS_bucket_compare(buckets[b1], buckets[b2]); });
+    AYS_arena_vector<uint32_t> rank(buckets.size(), 0, alloc);
+    AYS_arena_vector<AYS_bucket> sorted_buckets(buckets.size(), AYS_bucket(), alloc);
+    uint32_t offset = 0;
+    for (int r = 0; r < (int)sorted.size(); r++){
+        AYS_bucket b = buckets[sorted[r]];
+        rank[sorted[r]] = r;
+        b.begin = offset;
+        offset += b.end;
+        b.end = b.begin; // scatter cursor
+        sorted_buckets[r] = b;
+    }
+    for (int i = 0; i < (int)idx.size(); i++){
+        order[sorted_buckets[rank[bucket_of[i]]].end++] = idx[i];
+    }
+    buckets = std::move(sorted_buckets);
+}
+
+/*
+ * Candidate blocking for the clustering.
+ * Two names within the 0.25 cutoff are at most a quarter of their length apart, so they always share a
+ * byte bigram once both are padded with a start and end marker (each edit breaks at most two bigrams).
+ * An anchor is only a candidate for a fixture if every participant of the fixture shares a lower cased
+ * bigram with some participant of the anchor, everything else is skipped without running the Levenshtein
+ * matrix and the assignment. The filter never drops a real match.
+ */
+struct AYS_blocking_index {
+    AYS_arena_vector<AYS_arena_vector<uint32_t>> anchors; // bigram -> anchors having it, in creation order
+    AYS_arena_vector<uint32_t> used; // bigrams with anchors
+    AYS_arena_vector<int> count; // per anchor, participants of the current fixture matched so far
+    AYS_arena_vector<uint32_t> touched;
+    AYS_blocking_index(AYS_arena *arena = NULL) 
+        : anchors(257*257, AYS_arena_vector<uint32_t>(arena), arena)
+        , used(arena)
+        , count(arena)
+        , touched(arena) { }
+};
+
+// empties the index for the next bucket, the lists keep their memory
+void AYS_blocking_clear(AYS_blocking_index &index){
+    for (uint32_t bigram : index.used){
+        index.anchors[bigram].clear();
+    }
+    index.used.clear();
+    index.count.clear();
+}
+
+void AYS_blocking_add(AYS_blocking_index &index, const AYS_name_id *names, int participants, uint32_t anchor){
+    for (int j = 0; j < participants; j++){
+        for (uint32_t bigram : AYS_name_entry(names[j]).bigrams){
+            AYS_arena_vector<uint32_t> &list = index.anchors[bigram];
+            if (list.size() == 0){
+                index.used.push_back(bigram);
+            }
+            if (list.size() == 0 || list.back() != anchor){
+                list.push_back(anchor);
+            }
+        }
+    }
+    index.count.push_back(0);
+}
+
+// anchors that can be within the cutoff of names, in creation order
+void AYS_blocking_candidates(AYS_blocking_index &index, const AYS_name_id *names, int participants, AYS_arena_vector<uint32_t> &candidates){
+    candidates.clear();
+    index.touched.clear();
+    if (participants == 0){
+        for (uint32_t anchor = 0; anchor < index.count.size(); anchor++){
+            candidates.push_back(anchor);
+        }
+        return;
+    }
+    for (int j = 0; j < participants; j++){
+        for (uint32_t bigram : AYS_name_entry(names[j]).bigrams){
+            for (uint32_t anchor : index.anchors[bigram]){
+                if (index.count[anchor] != j) continue; // missed an earlier participant or already counted
+                if (j == 0){
+                    index.touched.push_back(anchor);
+                }
+                index.count[anchor] = j+1;
+            }
+        }
+    }
+    for (uint32_t anchor : index.touched){
+        if (index.count[anchor] == participants){
+            candidates.push_back(anchor);
+        }
+        index.count[anchor] = 0;
+    }
+    std::sort(candidates.begin(), candidates.end());
+}
+
+// the arb results of an event that do not depend on where its vectors live
+struct AYS_kept_arb {
+    float arb;
+    float not_arb;
+    float roi;
+    int max_not_arb_idx;
+};
+
+// clustering of a bucket kept from one scan to the next by AYS_dedup, fixtures are positions in the bucket
+struct AYS_bucket_clusters {
+    std::vector<uint32_t> fixtures; // cluster by cluster
+    std::vector<uint32_t> ends; // cluster c holds fixtures [ends[c-1], ends[c]), empty until the bucket is clustered
+    std::vector<uint8_t> slots; // the slots of the events, fixture by fixture
+    std::vector<uint64_t> names; // name hash per fixture, only a bucket with the same names reuses the clustering
+    uint32_t scan; // last scan of the bucket
+    // the arb results of the events for the content hash per fixture in hashes, empty for none. A bucket whose
+    // quotes are unchanged and hash the same takes them instead of evaluating its events again
+    std::vector<uint64_t> hashes;
+    std::vector<AYS_kept_arb> arbs; // per event
+    std::vector<int> max_idx; // per event, participants each
+    std::vector<int> max_not_idx;
+    uint32_t arb_scan; // last scan that kept or reused them
+    AYS_bucket_clusters() : scan(0), arb_scan(0) { }
+};
+
+// per worker state of AYS_cluster_bucket, reused from bucket to bucket
+struct AYS_cluster_scratch {
+    AYS_blocking_index index;
+    AYS_arena_vector<uint32_t> candidates;
+    std::vector<int> sol;
+    AYS_arena_vector<AYS_arena_vector<uint32_t>> cluster_fixtures; // the inner vectors move into the events
+    AYS_arena_vector<AYS_arena_vector<uint8_t>> cluster_slots;
+    AYS_cluster_scratch(AYS_arena *arena = NULL)
+        : index(arena)
+        , candidates(arena)
+        , cluster_fixtures(arena)
+        , cluster_slots(arena) { }
+};
+
+// cluster the fixtures of one bucket into events in a single pass, a fixture joins the first (oldest) anchor
+// whose names are within the 0.25 cutoff, otherwise it becomes a new anchor. This gives the same events as
+// repeatedly splitting the bucket on its first fixture.
+// With memo, a clustered memo gives the events without matching any name, an empty one gets the clustering.
+void AYS_cluster_bucket(const std::shared_ptr<const AYS_fixture_store> &store, 
+                        const AYS_arena_vector<uint32_t> &order, 
+                        const AYS_bucket &bucket, 
+                        AYS_match_cache *cache, 
+                        AYS_cluster_scratch &scratch, 
+                        std::vector<AYS_event> &result, 
+                        AYS_bucket_clusters *memo = NULL) {
+    const AYS_fixture_store &s = *store;
+    int participants = std::get<3>(bucket.key);
+    AYS_arena_vector<AYS_arena_vector<uint32_t>> &cluster_fixtures = scratch.cluster_fixtures;
+    AYS_arena_vector<AYS_arena_vector<uint8_t>> &cluster_slots = scratch.cluster_slots;
+    AYS_arena_allocator<uint32_t> alloc = cluster_fixtures.get_allocator();
+    if (memo && !memo->ends.empty()){
+        AYS_STAT_ADD(buckets_reused, 1);
+        uint32_t first = 0;
+        for (uint32_t end : memo->ends){
+            AYS_arena_vector<uint32_t> fixtures(alloc);
+            fixtures.reserve(end-first);
+            for (uint32_t k = first; k < end; k++){
+                fixtures.push_back(order[bucket.begin + memo->fixtures[k]]);
+            }
+            AYS_arena_vector<uint8_t> slots(memo->slots.begin() + first*participants, memo->slots.begin() + end*participants, alloc);
+            result.emplace_back(store, fixtures, slots);
+            first = end;
+        }
+        return;
+    }
+    AYS_blocking_index &index = scratch.index;
+    AYS_arena_vector<uint32_t> &candidates = scratch.candidates;
+    std::vector<int> &sol = scratch.sol;
+    AYS_blocking_clear(index);
+    cluster_fixtures.clear();
+    cluster_slots.clear();
+    for (uint32_t i = bucket.begin; i < bucket.end; i++){
+        uint32_t row = order[i];
+        const AYS_name_id *names = &s.participant_ids[s.offset[row]];
+        AYS_blocking_candidates(index, names, participants, candidates);
+        bool joined = false;
+        for (uint32_t c : candidates){
+            uint32_t anchor = cluster_fixtures[c][0];
+            float sim_score = similarity_sort(&s.participant_ids[s.offset[anchor]], names, participants, &sol, cache);
+            if (sim_score > 0.25){
+                AYS_STAT_ADD(threshold_rejections, 1);
+                continue;
+            }
+            cluster_fixtures[c].push_back(row);
+            cluster_slots[c].insert(cluster_slots[c].end(), sol.begin(), sol.end());
+            joined = true;
+            break;
+        }
+        if (joined) continue;
+        AYS_blocking_add(index, names, participants, cluster_fixtures.size());
+        cluster_fixtures.emplace_back(1, row, alloc);
+        cluster_slots.emplace_back(participants, 0, alloc);
+        for (int j = 0; j < participants; j++){
+            cluster_slots.back()[j] = j;
+        }
+    }
+    if (memo){
+        // rows increase within a bucket, which locates them
+        AYS_arena_vector<uint32_t>::const_iterator begin = order.begin() + bucket.begin, end = order.begin() + bucket.end;
+        for (int c = 0; c < (int)cluster_fixtures.size(); c++){
+            for (uint32_t row : cluster_fixtures[c]){
+                memo->fixtures.push_back(std::lower_bound(begin, end, row) - begin);
+            }
+            memo->ends.push_back(memo->fixtures.size());
+            memo->slots.insert(memo->slots.end(), cluster_slots[c].begin(), cluster_slots[c].end());
+        }
+    }
+    for (int c = 0; c < (int)cluster_fixtures.size(); c++){
+        result.emplace_back(store, cluster_fixtures[c], cluster_slots[c]);
+    }
+}
+
+/*
+ * Bound-based pruning of buckets.
+ * An entry (name, odds) of a fixture can only share a slot with an entry within the 0.25 cutoff of it, ie. at most
+ * d = floor(h/4) edits away (h the halved length sum). So the lengths differ by at most d and the names share all but
+ * 2d of the distinct lower cased bigrams of either name (each edit breaks at most two), call such entries compatible.
+ * A fixture can only join an anchor if every entry of the anchor has a compatible entry in it, linking those
+ * fixtures splits the bucket into groups that the clustering never mixes. In every event of a group, each slot
+ * holds an entry of the anchor and entries compatible with it, so the cheapest compatible odds bound the slot from
+ * below and the sums over the slots of every possible anchor bound arb and not_arb of all events of the group.
+ * Groups whose bound cannot reach the roi threshold are dropped before any Levenshtein distance is computed.
+ */
+struct AYS_bound_scratch {
+    AYS_arena_vector<const AYS_interned*> names; // per entry
+    AYS_arena_vector<AYS_arena_vector<uint32_t>> postings; // bigram -> entries having it
+    AYS_arena_vector<uint32_t> used; // bigrams with a non empty posting
+    AYS_arena_vector<uint32_t> common; // per entry, bigrams shared with the current entry
+    AYS_arena_vector<uint32_t> touched;
+    AYS_arena_vector<std::pair<uint32_t, uint32_t>> compatible; // (entry of the current fixture, compatible entry)
+    AYS_arena_vector<uint32_t> covered; // per fixture, entries of the current fixture with a compatible entry in it
+    AYS_arena_vector<uint32_t> stamp;
+    AYS_arena_vector<uint32_t> group; // union find over the fixtures
+    AYS_arena_vector<float> best; // per slot of the current anchor
+    AYS_arena_vector<float> best_not;
+    AYS_arena_vector<float> anchor_arb; // per fixture as an anchor
+    AYS_arena_vector<float> anchor_not_arb;
+    AYS_arena_vector<float> bound_arb; // per group
+    AYS_arena_vector<float> bound_not_arb;
+    AYS_arena_vector<int32_t> group_idx;
+    AYS_bound_scratch(AYS_arena *arena = NULL)
+        : names(arena)
+        , postings(257*257, AYS_arena_vector<uint32_t>(arena), arena)
+        , used(arena)
+        , common(arena)
+        , touched(arena)
+        , compatible(arena)
+        , covered(arena)
+        , stamp(arena)
+        , group(arena)
+        , best(arena)
+        , best_not(arena)
+        , anchor_arb(arena)
+        , anchor_not_arb(arena)
+        , bound_arb(arena)
+        , bound_not_arb(arena)
+        , group_idx(arena) { }
+};
+
+uint32_t AYS_group_find(AYS_arena_vector<uint32_t> &group, uint32_t f){
+    while (group[f] != f){
+        group[f] = group[group[f]];
+        f = group[f];
+    }
+    return f;
+}
+
+bool AYS_entries_compatible(const AYS_participant &n1, const AYS_participant &n2, 
+                            const std::vector<uint32_t> &b1, const std::vector<uint32_t> &b2, uint32_t shared){
+    int d = AYS_name_max_distance(n1, n2);
+    if ((int)std::max(n1.size(), n2.size()) - (int)std::min(n1.size(), n2.size()) > d) return false;
+    return (int)shared >= (int)std::max(b1.size(), b2.size()) - 2*d;
+}
+
+// numbers the groups of the bucket that can reach min_roi in bucket order, group[f] of fixture f of the bucket
+// is its group or -1 if pruned. Returns the number of groups
+uint32_t AYS_bucket_prune(const AYS_fixture_store &store, 
+                          const AYS_arena_vector<uint32_t> &order, 
+                          const AYS_bucket &bucket, 
+                          float min_roi, 
+                          AYS_bound_scratch &scratch, 
+                          int32_t *group) {
+    int n = std::get<3>(bucket.key);
+    uint32_t fixtures = bucket.end-bucket.begin;
+    if (n == 0){ // arb 0, nothing to bound
+        std::fill(group, group+fixtures, 0);
+        return fixtures > 0;
+    }
+    uint32_t entries = fixtures*n;
+    auto entry = [&](uint32_t e){ return store.offset[order[bucket.begin + e/n]] + e%n; };
+    scratch.names.resize(entries);
+    for (uint32_t bigram : scratch.used){
+        scratch.postings[bigram].clear();
+    }
+    scratch.used.clear();
+    size_t max_len = 0;
+    for (uint32_t e = 0; e < entries; e++){
+        scratch.names[e] = &AYS_name_entry(store.participant_ids[entry(e)]);
+        max_len = std::max(max_len, scratch.names[e]->folded.size());
+        for (uint32_t bigram : scratch.names[e]->bigrams){
+            if (scratch.postings[bigram].size() == 0){
+                scratch.used.push_back(bigram);
+            }
+            scratch.postings[bigram].push_back(e);
+        }
+    }
+    scratch.common.assign(entries, 0);
+    scratch.covered.assign(fixtures, 0);
+    scratch.stamp.assign(fixtures, entries);
+    scratch.group.resize(fixtures);
+    for (uint32_t f = 0; f < fixtures; f++){
+        scratch.group[f] = f;
+    }
+    AYS_arena_vector<float> &anchor_arb = scratch.anchor_arb;
+    AYS_arena_vector<float> &anchor_not_arb = scratch.anchor_not_arb;
+    anchor_arb.assign(fixtures, 0);
+    anchor_not_arb.assign(fixtures, std::numeric_limits<float>::infinity());
+    for (uint32_t f = 0; f < fixtures; f++){
+        scratch.compatible.clear();
+        for (uint32_t e = f*n; e < (f+1)*n; e++){
+            const AYS_participant &name = scratch.names[e]->folded;
+            // a name with few bigrams can be within the cutoff without sharing any, then every entry is a candidate
+            bool scan_all = (int)scratch.names[e]->bigrams.size() <= 2*(int)(((name.size() + max_len) >> 1)/4);
+            scratch.touched.clear();
+            if (scan_all){
+                for (uint32_t c = 0; c < entries; c++){
+                    scratch.touched.push_back(c);
+                }
+            } else {
+                for (uint32_t bigram : scratch.names[e]->bigrams){
+                    for (uint32_t c : scratch.postings[bigram]){
+                        if (scratch.common[c]++ == 0){
+                            scratch.touched.push_back(c);
+                        }
+                    }
+                }
+            }
+            for (uint32_t c : scratch.touched){
+                uint32_t shared = scratch.common[c];
+                scratch.common[c] = 0;
+                if (c/n == f) continue; // same fixture, never the same slot
+                const std::vector<uint32_t> &b1 = scratch.names[e]->bigrams;
+                const std::vector<uint32_t> &b2 = scratch.names[c]->bigrams;
+                if (scan_all){
+                    shared = 0;
+                    for (size_t i = 0, j = 0; i < b1.size() && j < b2.size();){
+                        if (b1[i] < b2[j]) i++;
+                        else if (b1[i] > b2[j]) j++;
+                        else { shared++; i++; j++; }
+                    }
+                }
+                if (!AYS_entries_compatible(name, scratch.names[c]->folded, b1, b2, shared)) continue;
+                scratch.compatible.push_back(std::make_pair(e, c));
+                if (scratch.stamp[c/n] != e){
+                    scratch.stamp[c/n] = e;
+                    scratch.covered[c/n]++;
+                }
+            }
+        }
+        // the slot bounds of f as an anchor only count the fixtures that can join it
+        AYS_arena_vector<float> &best = scratch.best;
+        AYS_arena_vector<float> &best_not = scratch.best_not;
+        best.resize(n);
+        best_not.resize(n);
+        for (int k = 0; k < n; k++){
+            best[k] = std::min(1.f, AYS_odds_float(store.participant_odds[entry(f*n+k)]));
+            best_not[k] = std::min(1.f, AYS_odds_float(store.participant_not_odds[entry(f*n+k)]));
+        }
+        for (auto& p : scratch.compatible){
+            uint32_t g = p.second/n;
+            if (scratch.covered[g] != (uint32_t)n) continue;
+            best[p.first%n] = std::min(best[p.first%n], AYS_odds_float(store.participant_odds[entry(p.second)]));
+            best_not[p.first%n] = std::min(best_not[p.first%n], AYS_odds_float(store.participant_not_odds[entry(p.second)]));
+        }
+        for (auto& p : scratch.compatible){
+            uint32_t g = p.second/n;
+            if (scratch.covered[g] == (uint32_t)n){
+                scratch.group[AYS_group_find(scratch.group, f)] = AYS_group_find(scratch.group, g);
+            }
+            scratch.covered[g] = 0;
+            scratch.stamp[g] = entries;
+        }
+        for (int k = 0; k < n; k++){
+            anchor_arb[f] += best[k];
+            anchor_not_arb[f] = std::min(anchor_not_arb[f], best[k]+best_not[k]);
+        }
+    }
+    scratch.bound_arb.assign(fixtures, std::numeric_limits<float>::infinity());
+    scratch.bound_not_arb.assign(fixtures, std::numeric_limits<float>::infinity());
+    for (uint32_t f = 0; f < fixtures; f++){
+        uint32_t root = AYS_group_find(scratch.group, f);
+        scratch.bound_arb[root] = std::min(scratch.bound_arb[root], anchor_arb[f]);
+        scratch.bound_not_arb[root] = std::min(scratch.bound_not_arb[root], anchor_not_arb[f]);
+    }
+    scratch.group_idx.assign(fixtures, -1);
+    uint32_t groups = 0;
+    for (uint32_t f = 0; f < fixtures; f++){
+        uint32_t root = AYS_group_find(scratch.group, f);
+        group[f] = -1;
+        // a little slack absorbs the different summation order of AYS_event_arb
+        if (100/std::min(scratch.bound_arb[root], scratch.bound_not_arb[root])-100 < min_roi - 1e-3f) continue;
+        if (scratch.group_idx[root] < 0){
+            scratch.group_idx[root] = groups++;
+        }
+        group[f] = scratch.group_idx[root];
+    }
+    return groups;
+}
+
+/*
+ * Work stealing over independent work items (buckets), each worker owns a deque seeded with a contiguous
+ * range of items, pops from its front and steals from the back of the others when it runs dry.
+ */
+struct AYS_work_queue {
+    std::mutex lock;
+    std::deque<uint32_t> items;
+};
+
+bool AYS_work_next(std::vector<AYS_work_queue> &queues, int self, uint32_t *item){
+    {
+        std::lock_guard<std::mutex> guard(queues[self].lock);
+        if (queues[self].items.size() > 0){
+            *item = queues[self].items.front();
+            queues[self].items.pop_front();
+            return true;
+        }
+    }
+    for (int k = 1; k < (int)queues.size(); k++){
+        AYS_work_queue &victim = queues[(self+k) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (victim.items.size() > 0){
+            *item = victim.items.back();
+            victim.items.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+// runs work(worker, item) for every item in [0, items) on threads workers, threads <= 1 runs inline
+template<typename F>
+void AYS_parallel_for(int threads, uint32_t items, F work){
+    if (threads <= 1 || items <= 1){
+        for (uint32_t item = 0; item < items; item++){
+            work(0, item);
+        }
+        return;
+    }
+    threads = std::min<uint32_t>(threads, items);
+    std::vector<AYS_work_queue> queues(threads);
+    for (int t = 0; t < threads; t++){
+        for (uint32_t item = (uint64_t)items*t/threads; item < (uint64_t)items*(t+1)/threads; item++){
+            queues[t].items.push_back(item);
+        }
+    }
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++){
+        workers.emplace_back([&queues, &work, t](){
+            uint32_t item;
+            while (AYS_work_next(queues, t, &item)){
+                work(t, item);
+            }
+        });
+    }
+    for (auto& worker : workers){
+        worker.join();
+    }
+}
+
+// replaces the buckets by their groups that can reach min_roi, clustering the groups as buckets of their own
+// gives the same events as clustering the whole buckets. With a scan arena (reset for threads) the workers
+// allocate from their arenas, the rest comes from the allocator of order
+void AYS_prune_buckets(const AYS_fixture_store &store, 
+                       AYS_arena_vector<uint32_t> &order, 
+                       AYS_arena_vector<AYS_bucket> &buckets, 
+                       float min_roi, 
+                       int threads = 1, 
+                       AYS_scan_arena *arena = NULL) {
+    AYS_arena_allocator<uint32_t> alloc = order.get_allocator();
+    AYS_arena_vector<int32_t> group(order.size(), -1, alloc); // per position in order
+    AYS_arena_vector<uint32_t> groups(buckets.size(), 0, alloc); // per bucket
+    AYS_arena_vector<AYS_bound_scratch> scratch(alloc);
+    scratch.reserve(std::max(1, threads));
+    for (int worker = 0; worker < std::max(1, threads); worker++){
+        scratch.emplace_back(AYS_scan_arena_get(arena, worker));
+    }
+    AYS_parallel_for(threads, buckets.size(), [&](int worker, uint32_t b){
+        groups[b] = AYS_bucket_prune(store, order, buckets[b], min_roi, scratch[worker], &group[buckets[b].begin]);
+    });
+    AYS_arena_vector<uint32_t> kept_order(alloc);
+    AYS_arena_vector<AYS_bucket> kept(alloc);
+    AYS_arena_vector<uint32_t> cursor(alloc);
+    kept_order.reserve(order.size());
+    for (size_t b = 0; b < buckets.size(); b++){
+        AYS_STAT_ADD(buckets_pruned, groups[b] == 0);
+        // counting sort of the kept fixtures by group, the fixtures keep their bucket order within a group
+        cursor.assign(groups[b]+1, 0);
+        for (uint32_t i = buckets[b].begin; i < buckets[b].end; i++){
+            if (group[i] >= 0) cursor[group[i]+1]++;
+        }
+        for (uint32_t g = 0; g < groups[b]; g++){
+            cursor[g+1] += cursor[g];
+            AYS_bucket sub = {buckets[b].key, (uint32_t)kept_order.size() + cursor[g], (uint32_t)kept_order.size() + cursor[g+1]};
+            kept.push_back(sub);
+        }
+        uint32_t base = kept_order.size();
+        kept_order.resize(base + cursor[groups[b]]);
+        for (uint32_t i = buckets[b].begin; i < buckets[b].end; i++){
+            if (group[i] >= 0) kept_order[base + cursor[group[i]]++] = order[i];
+        }
+    }
+    order = std::move(kept_order);
+    buckets = std::move(kept);
+}
+
+/*
+ * Provider deduplication.
+ * Providers resend their quotes whether they changed or not. AYS_dedup_batch keeps one quote per (pid, id, btid,
+ * line) of a batch, the last one at its own position, and drops the exact duplicates and the superseded quotes
+ * before it. The quotes kept are flagged unchanged when their content hash (times, sport, currency, max bet, names
+ * and odds) equals the one of their key in an earlier batch. Keys missing from keep batches in a row are forgotten,
+ * 0 keeps them forever.
+ * A scan with AYS_scan_options::dedup runs the stage before storing the fixtures and reuses prior clusterings. The
+ * clustering of a bucket only depends on the names of its fixtures in order, so every bucket is signed with the
+ * hashes of those names and a bucket with the same names as one of the previous scan takes its clustering from
+ * there instead of matching names again, whether or not the odds moved. When none of its quotes changed either, the
+ * bucket also takes the arb results of its events from there instead of evaluating them.
+ */
+struct AYS_dedup_key {
+    AYS_provider_id pid;
+    AYS_fixture_id id;
+    AYS_bet_type_id btid;
+    int line;
+    bool operator==(const AYS_dedup_key &other) const {
+        return pid == other.pid && id == other.id && btid == other.btid && line == other.line;
+    }
+};
+
+struct AYS_dedup_key_hash {
+    size_t operator()(const AYS_dedup_key &k) const {
+        uint64_t h = ((uint64_t)k.pid << 32) | k.id;
+        h = h*0x9E3779B97F4A7C15ull ^ k.btid;
+        h = h*0x9E3779B97F4A7C15ull ^ (uint32_t)k.line;
+        return h ^ (h >> 29);
+    }
+};
+
+struct AYS_dedup_entry {
+    uint64_t hash; // content of the key's quote as of the last batch it was in
+    uint32_t hashed; // that batch, 0 for none yet
+    uint32_t seen; // last batch the key was in
+    uint32_t pos; // quote of the key kept in batch seen
+};
+
+struct AYS_dedup {
+    uint32_t keep;
+    uint32_t batch; // batches deduplicated
+    uint32_t scan; // scans that used the clusters
+    std::unordered_map<AYS_dedup_key, AYS_dedup_entry, AYS_dedup_key_hash> entries;
+    std::unordered_map<uint64_t, AYS_bucket_clusters> clusters; // by bucket signature
+    // per quote kept of the last batch, in batch order
+    std::vector<uint64_t> hashes;
+    std::vector<uint64_t> name_hashes;
+    std::vector<uint8_t> unchanged;
+    std::vector<uint32_t> row_quotes; // quote per row of the store of the current scan, set by AYS_fixtures_to_events
+    std::vector<AYS_dedup_entry*> quote_entry; // scratch, per quote of the batch
+    // totals over the batches
+    uint64_t quotes;
+    uint64_t duplicates;
+    uint64_t superseded;
+    uint64_t unchanged_quotes;
+    uint64_t events_reused; // arb results taken from the previous scan
+    AYS_dedup(uint32_t keep = 1)
+        : keep(keep)
+        , batch(0)
+        , scan(0)
+        , quotes(0)
+        , duplicates(0)
+        , superseded(0)
+        , unchanged_quotes(0)
+        , events_reused(0) { }
+};
+
+uint64_t AYS_hash_mix(uint64_t h, uint64_t v){
+    h = (h ^ v)*0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+uint64_t AYS_odd_bits(AYS_odd odd){
+    uint32_t bits;
+    memcpy(&bits, &odd, sizeof(bits));
+    return bits;
+}
+
+// content of a fixture besides its (pid, id), equal fixtures hash equal. names gets the hash of the names alone
+uint64_t AYS_fixture_hash(const AYS_fixture &f, uint64_t *names = NULL){
+    uint64_t n = f.participant_names.size();
+    uint64_t h = AYS_hash_mix((uint64_t)f.start_time, (uint64_t)f.expiry_time);
+    h = AYS_hash_mix(h, ((uint64_t)f.sid << 32) | f.btid);
+    h = AYS_hash_mix(h, (uint32_t)f.line);
+    h = AYS_hash_mix(h, std::hash<std::string>()(f.currency));
+    h = AYS_hash_mix(h, AYS_odd_bits(f.max_nominal_bet));
+    for (size_t j = 0; j < f.participant_names.size(); j++){
+        n = AYS_hash_mix(n, std::hash<std::string>()(f.participant_names[j]));
+        h = AYS_hash_mix(h, (AYS_odd_bits(j < f.participant_odds.size() ? f.participant_odds[j] : 0) << 32) | 
+                            AYS_odd_bits(j < f.participant_not_odds.size() ? f.participant_not_odds[j] : 0));
+    }
+    if (names) *names = n;
+    return AYS_hash_mix(h, n);
+}
+
+// removes the duplicate and superseded quotes of fs, the quotes kept stay in order. Fills dedup.hashes and
+// dedup.name_hashes and dedup.unchanged for them and returns how many were dropped
+size_t AYS_dedup_batch(AYS_dedup &dedup, std::vector<AYS_fixture> &fs){
+    AYS_STAT_TIMER(AYS_STAGE_DEDUP);
+    uint32_t batch = ++dedup.batch;
+    dedup.hashes.resize(fs.size());
+    dedup.name_hashes.resize(fs.size());
+    dedup.quote_entry.resize(fs.size());
+    size_t duplicates = 0, superseded = 0;
+    for (uint32_t i = 0; i < fs.size(); i++){
+        const AYS_fixture &f = fs[i];
+        AYS_dedup_entry &entry = dedup.entries.emplace(AYS_dedup_key{f.pid, f.id, f.btid, f.line}, AYS_dedup_entry{0, 0, 0, 0}).first->second;
+        dedup.hashes[i] = AYS_fixture_hash(f, &dedup.name_hashes[i]);
+        if (entry.seen == batch){ // the later quote wins
+            if (dedup.hashes[entry.pos] == dedup.hashes[i]) duplicates++;
+            else superseded++;
+        }
+        entry.seen = batch;
+        entry.pos = i;
+        dedup.quote_entry[i] = &entry; // elements of an unordered_map stay put
+    }
+    dedup.unchanged.resize(fs.size());
+    size_t kept = 0, unchanged = 0;
+    for (uint32_t i = 0; i < fs.size(); i++){
+        AYS_dedup_entry &entry = *dedup.quote_entry[i];
+        if (entry.pos != i) continue;
+        dedup.unchanged[kept] = entry.hashed != 0 && entry.hash == dedup.hashes[i];
+        unchanged += dedup.unchanged[kept];
+        entry.hash = dedup.hashes[i];
+        entry.hashed = batch;
+        dedup.hashes[kept] = dedup.hashes[i];
+        dedup.name_hashes[kept] = dedup.name_hashes[i];
+        if (kept != i) fs[kept] = std::move(fs[i]);
+        kept++;
+    }
+    fs.erase(fs.begin() + kept, fs.end());
+    dedup.hashes.resize(kept);
+    dedup.name_hashes.resize(kept);
+    dedup.unchanged.resize(kept);
+    if (dedup.keep > 0 && batch > dedup.keep){
+        for (auto it = dedup.entries.begin(); it != dedup.entries.end();){
+            if (it->second.seen + dedup.keep <= batch) it = dedup.entries.erase(it);
+            else ++it;
+        }
+    }
+    dedup.quotes += kept + duplicates + superseded;
+    dedup.duplicates += duplicates;
+    dedup.superseded += superseded;
+    dedup.unchanged_quotes += unchanged;
+    AYS_STAT_ADD(fixtures_duplicate, duplicates);
+    AYS_STAT_ADD(fixtures_superseded, superseded);
+    AYS_STAT_ADD(fixtures_unchanged, unchanged);
+    return duplicates + superseded;
+}
+
+// points memo[b] at the clustering of bucket b kept by dedup, a new empty one if the previous scan had no bucket
+// with its names. Buckets with the same names share it, only the first fills an empty one. Forgets the clusterings
+// of the previous scan that were not used
+void AYS_dedup_clusters(AYS_dedup &dedup, 
+                        const AYS_arena_vector<uint32_t> &order, 
+                        const AYS_arena_vector<AYS_bucket> &buckets, 
+                        AYS_arena_vector<AYS_bucket_clusters*> &memo) {
+    uint32_t scan = ++dedup.scan;
+    memo.resize(buckets.size());
+    for (size_t b = 0; b < buckets.size(); b++){
+        uint32_t size = buckets[b].end - buckets[b].begin;
+        int participants = std::get<3>(buckets[b].key);
+        uint64_t h = AYS_hash_mix(size, participants);
+        for (uint32_t i = buckets[b].begin; i < buckets[b].end; i++){
+            h = AYS_hash_mix(h, dedup.name_hashes[dedup.row_quotes[order[i]]]);
+        }
+        AYS_bucket_clusters &clusters = dedup.clusters[h];
+        bool same = clusters.names.size() == size && clusters.slots.size() == (size_t)size*participants;
+        for (uint32_t i = buckets[b].begin; same && i < buckets[b].end; i++){
+            same = clusters.names[i - buckets[b].begin] == dedup.name_hashes[dedup.row_quotes[order[i]]];
+        }
+        if (clusters.ends.empty() ? clusters.scan == scan : !same){
+            memo[b] = NULL; // another bucket fills it, or a colliding signature
+            continue;
+        }
+        if (clusters.ends.empty()){
+            clusters.names.clear();
+            for (uint32_t i = buckets[b].begin; i < buckets[b].end; i++){
+                clusters.names.push_back(dedup.name_hashes[dedup.row_quotes[order[i]]]);
+            }
+        }
+        clusters.scan = scan;
+        memo[b] = &clusters;
+    }
+    for (auto it = dedup.clusters.begin(); it != dedup.clusters.end();){
+        if (it->second.scan != scan) it = dedup.clusters.erase(it);
+        else ++it;
+    }
+}
+
+// true when the quotes of bucket b are unchanged and hash like the ones memo[b] kept the arb results for
+bool AYS_dedup_arbs_hold(const AYS_dedup &dedup, 
+                         const AYS_arena_vector<uint32_t> &order, 
+                         const AYS_bucket &bucket, 
+                         const AYS_bucket_clusters &clusters) {
+    if (clusters.hashes.size() != bucket.end - bucket.begin) return false;
+    for (uint32_t i = bucket.begin; i < bucket.end; i++){
+        uint32_t quote = dedup.row_quotes[order[i]];
+        if (!dedup.unchanged[quote] || clusters.hashes[i - bucket.begin] != dedup.hashes[quote]) return false;
+    }
+    return true;
+}
+
+// gives the events of the buckets whose arb results hold (AYS_dedup_arbs_hold) those results, appends the other
+// events to evaluate. Bucket b holds events [first[b], first[b+1]) of result
+void AYS_dedup_restore_arbs(AYS_dedup &dedup, 
+                            const AYS_arena_vector<uint32_t> &order, 
+                            const AYS_arena_vector<AYS_bucket> &buckets, 
+                            const AYS_arena_vector<AYS_bucket_clusters*> &memo, 
+                            const AYS_arena_vector<uint32_t> &first, 
+                            std::vector<AYS_event> &result, 
+                            AYS_arena_vector<uint32_t> &evaluate) {
+    size_t reused = 0;
+    for (size_t b = 0; b < buckets.size(); b++){
+        AYS_bucket_clusters *clusters = memo[b];
+        if (!clusters || clusters->arb_scan == dedup.scan || !AYS_dedup_arbs_hold(dedup, order, buckets[b], *clusters)){
+            for (uint32_t e = first[b]; e < first[b+1]; e++){
+                evaluate.push_back(e);
+            }
+            continue;
+        }
+        clusters->arb_scan = dedup.scan; // buckets with the same names but other quotes keep theirs
+        uint32_t offset = 0;
+        for (uint32_t e = first[b]; e < first[b+1]; e++){
+            AYS_event &event = result[e];
+            const AYS_kept_arb &kept = clusters->arbs[e - first[b]];
+            event.arb = kept.arb;
+            event.not_arb = kept.not_arb;
+            event.roi = kept.roi;
+            event.max_not_arb_idx = kept.max_not_arb_idx;
+            // within the capacity reserved by the event
+            event.max_idx.assign(clusters->max_idx.begin() + offset, clusters->max_idx.begin() + offset + event.participants);
+            event.max_not_idx.assign(clusters->max_not_idx.begin() + offset, clusters->max_not_idx.begin() + offset + event.participants);
+            offset += event.participants;
+        }
+        reused += first[b+1] - first[b];
+    }
+    dedup.events_reused += reused;
+    AYS_STAT_ADD(events_reused, reused);
+}
+
+// keeps the arb results of the evaluated events in the memo of their bucket for the next scan, the first bucket
+// of a memo keeps them
+void AYS_dedup_keep_arbs(AYS_dedup &dedup, 
+                         const AYS_arena_vector<uint32_t> &order, 
+                         const AYS_arena_vector<AYS_bucket> &buckets, 
+                         const AYS_arena_vector<AYS_bucket_clusters*> &memo, 
+                         const AYS_arena_vector<uint32_t> &first, 
+                         const std::vector<AYS_event> &result) {
+    for (size_t b = 0; b < buckets.size(); b++){
+        AYS_bucket_clusters *clusters = memo[b];
+        if (!clusters || clusters->arb_scan == dedup.scan) continue;
+        clusters->arb_scan = dedup.scan;
+        clusters->hashes.clear();
+        for (uint32_t i = buckets[b].begin; i < buckets[b].end; i++){
+            clusters->hashes.push_back(dedup.hashes[dedup.row_quotes[order[i]]]);
+        }
+        clusters->arbs.clear();
+        clusters->max_idx.clear();
+        clusters->max_not_idx.clear();
+        for (uint32_t e = first[b]; e < first[b+1]; e++){
+            const AYS_event &event = result[e];
+            clusters->arbs.push_back(AYS_kept_arb{event.arb, event.not_arb, event.roi, event.max_not_arb_idx});
+            clusters->max_idx.insert(clusters->max_idx.end(), event.max_idx.begin(), event.max_idx.end());
+            clusters->max_not_idx.insert(clusters->max_not_idx.end(), event.max_not_idx.begin(), event.max_not_idx.end());
+        }
+    }
+}
+
+struct AYS_scan_options {
+    bool include_live;
+    AYS_match_cache *cache;
+    int threads; // > 1 clusters the buckets and evaluates the arbs in parallel, the result is the same as with 1 thread
+    float min_roi; // only events with roi >= min_roi are returned, buckets that cannot reach it are never clustered
+    size_t top_k; // only the top_k events with the highest roi are returned, 0 returns all
+    // optional, reset at the start of the scan, the temporaries and the vectors of the returned events come from it
+    // instead of the heap, so the events are only valid until the next scan with the same arena
+    AYS_scan_arena *arena;
+    const AYS_clock *clock; // time of the expiry and live filters, NULL for the default clock
+    AYS_feed_recorder *recorder; // optional, AYS_fixtures_to_events appends its fixtures to it
+    AYS_dedup *dedup; // optional, AYS_fixtures_to_events deduplicates its fixtures and reuses unchanged clusterings
+    AYS_scan_options(bool include_live = false, AYS_match_cache *cache = NULL, int threads = 1)
+        : include_live(include_live)
+        , cache(cache)
+        , threads(threads)
+        , min_roi(-std::numeric_limits<float>::infinity())
+        , top_k(0)
+        , arena(NULL)
+        , clock(NULL)
+        , recorder(NULL)
+        , dedup(NULL) { }
+};
+
+// events sorted by ascending roi
+std::vector<AYS_event> AYS_store_to_events(std::shared_ptr<const AYS_fixture_store> store, const AYS_scan_options &options) {
+    bool includeLive = options.include_live;
+    AYS_match_cache *cache = options.cache;
+    int threads = options.threads;
+    AYS_STAT_TIMER(AYS_STAGE_SCAN);
+    AYS_STAT_ADD(scans, 1);
+    if (options.arena){
+        AYS_scan_arena_reset(*options.arena, threads);
+    }
+    AYS_arena *arena = AYS_scan_arena_get(options.arena, -1);
+    std::vector<AYS_event> result;
+    const AYS_fixture_store &s = *store;
+    time_t now = AYS_now(options.clock);
+    AYS_arena_vector<uint32_t> filtered_idx(arena);
+    filtered_idx.reserve(AYS_store_size(s));
+    {
+        AYS_STAT_TIMER(AYS_STAGE_FILTER);
+        for (uint32_t row = 0; row < AYS_store_size(s); row++) {
+            if (AYS_store_filter(s, row, now, includeLive)){
+                filtered_idx.push_back(row);
+            }
+        }
+    }
+    AYS_STAT_ADD(fixtures_scanned, filtered_idx.size());
+
+    AYS_arena_vector<uint32_t> order(arena);
+    AYS_arena_vector<AYS_bucket> buckets(arena);
+    {
+        AYS_STAT_TIMER(AYS_STAGE_BUCKET);
+        AYS_bucket_fixtures(s, filtered_idx, order, buckets);
+    }
+    AYS_STAT_ADD(buckets, buckets.size());
+    if (options.min_roi > -std::numeric_limits<float>::infinity()){
+        AYS_STAT_TIMER(AYS_STAGE_PRUNE);
+        AYS_prune_buckets(s, order, buckets, options.min_roi, threads, options.arena);
+    }
+    // per bucket, NULL clusters it as usual
+    AYS_arena_vector<AYS_bucket_clusters*> memo(buckets.size(), NULL, arena);
+    AYS_dedup *dedup = options.dedup && options.dedup->row_quotes.size() == AYS_store_size(s) ? options.dedup : NULL;
+    if (dedup){
+        AYS_dedup_clusters(*dedup, order, buckets, memo);
+    }
+    AYS_arena_vector<uint32_t> first(buckets.size()+1, 0, arena); // bucket b holds events [first[b], first[b+1])
+    AYS_arena_vector<uint32_t> evaluate(arena); // the events whose arb results are not reused
+    if (threads <= 1){
+        {
+            AYS_STAT_TIMER(AYS_STAGE_CLUSTER);
+            AYS_cluster_scratch scratch(AYS_scan_arena_get(options.arena, 0));
+            for (size_t b = 0; b < buckets.size(); b++){
+                AYS_cluster_bucket(store, order, buckets[b], cache, scratch, result, memo[b]);
+                first[b+1] = result.size();
+            }
+        }
+        AYS_STAT_TIMER(AYS_STAGE_ARB);
+        AYS_arb_batch batch(arena);
+        if (dedup){
+            AYS_dedup_restore_arbs(*dedup, order, buckets, memo, first, result, evaluate);
+            AYS_events_arb(result, batch, &evaluate);
+            AYS_dedup_keep_arbs(*dedup, order, buckets, memo, first, result);
+        } else {
+            AYS_events_arb(result, batch);
+        }
+    } else {
+        {
+            AYS_STAT_TIMER(AYS_STAGE_CLUSTER);
+            // every worker appends to its own events, span[b] locates the events of bucket b
+            std::vector<std::vector<AYS_event>> worker_events(threads);
+            AYS_arena_vector<AYS_cluster_scratch> scratch(arena);
+            scratch.reserve(threads);
+            for (int worker = 0; worker < threads; worker++){
+                scratch.emplace_back(AYS_scan_arena_get(options.arena, worker));
+            }
+            AYS_arena_vector<std::tuple<int, uint32_t, uint32_t>> span(buckets.size(), std::make_tuple(0, 0u, 0u), arena);
+            AYS_parallel_for(threads, buckets.size(), [&](int worker, uint32_t b){
+                uint32_t begin = worker_events[worker].size();
+                AYS_cluster_bucket(store, order, buckets[b], cache, scratch[worker], worker_events[worker], memo[b]);
+                span[b] = std::make_tuple(worker, begin, (uint32_t)worker_events[worker].size());
+            });
+            size_t events = 0;
+            for (auto& we : worker_events){
+                events += we.size();
+            }
+            result.reserve(events);
+            for (size_t b = 0; b < buckets.size(); b++){ // merge in bucket order, same as the sequential scan
+                std::vector<AYS_event> &we = worker_events[std::get<0>(span[b])];
+                std::move(we.begin() + std::get<1>(span[b]), we.begin() + std::get<2>(span[b]), std::back_inserter(result));
+                first[b+1] = result.size();
+            }
+        }
+        AYS_STAT_TIMER(AYS_STAGE_ARB);
+        if (dedup){
+            AYS_dedup_restore_arbs(*dedup, order, buckets, memo, first, result, evaluate);
+        } else {
+            evaluate.reserve(result.size());
+            for (uint32_t e = 0; e < result.size(); e++){
+                evaluate.push_back(e);
+            }
+        }
+        const uint32_t chunk = 4096;
+        AYS_arena_vector<AYS_arb_batch> batches(arena);
+        batches.reserve(threads);
+        for (int worker = 0; worker < threads; worker++){
+            batches.emplace_back(AYS_scan_arena_get(options.arena, worker));
+        }
+        AYS_parallel_for(threads, (evaluate.size()+chunk-1)/chunk, [&](int worker, uint32_t c){
+            AYS_arena_vector<uint32_t> subset(evaluate.begin() + c*chunk, evaluate.begin() + std::min<size_t>(evaluate.size(), (c+1)*chunk), 
+                                              AYS_scan_arena_get(options.arena, worker));
+            AYS_events_arb(result, batches[worker], &subset);
+        });
+        if (dedup){
+            AYS_dedup_keep_arbs(*dedup, order, buckets, memo, first, result);
+        }
+    }
+#ifdef AYS_STATS
+    AYS_STAT_ADD(events, result.size());
+    for (auto& event : result){
+        if (event.roi > 0) AYS_STAT_ADD(events_positive_roi, 1);
+    }
+#endif
+
+    AYS_STAT_TIMER(AYS_STAGE_SORT);
+    if (options.min_roi > -std::numeric_limits<float>::infinity()){
+        float min_roi = options.min_roi;
+        result.erase(std::remove_if(result.begin(), result.end(), [min_roi](const AYS_event &e){ return !(e.roi >= min_roi); }), 
+                     result.end());
+    }
+    if (options.top_k > 0 && options.top_k < result.size()){
+        // the top_k best go to the back, the same place a full sort puts them
+        std::nth_element(result.begin(), result.end()-options.top_k, result.end(), AYS_roi_compare);
+        result.erase(result.begin(), result.end()-options.top_k);
+    }
+    std::sort(result.begin(), result.end(), AYS_roi_compare);
+    return result;
+}
+
+std::vector<AYS_event> AYS_store_to_events(std::shared_ptr<const AYS_fixture_store> store, bool includeLive, AYS_match_cache *cache = NULL, int threads = 1) {
+    return AYS_store_to_events(store, AYS_scan_options(includeLive, cache, threads));
+}
+
+std::vector<AYS_event> AYS_fixtures_to_events(std::vector<AYS_fixture> fs, const AYS_scan_options &options) {
+    time_t now = AYS_now(options.clock);
+    if (options.recorder){
+        AYS_recorder_append(*options.recorder, fs, now);
+    }
+    AYS_dedup *dedup = options.dedup;
+    if (dedup){
+        AYS_dedup_batch(*dedup, fs);
+        dedup->row_quotes.clear();
     }
-    for (int from = 2; from < nodeNum-1; from+=2){ // tasks to sink
-        fromNode = nodes[from];
-        arc = g.addArc(fromNode, sinkNode);
-        capacities[arc] = 1;
-        weights[arc] = 1;
-        //std::cout << "edge: " << from << "->" << sinkIDX << " @ " << weights[arc] << std::endl ;
-        arcs[arcIDX++] = arc;
+    std::shared_ptr<AYS_fixture_store> store = std::make_shared<AYS_fixture_store>();
+    {
+        AYS_STAT_TIMER(AYS_STAGE_STORE);
+        AYS_store_reserve(*store, fs.size(), fs.size()*3);
+        for (uint32_t i = 0; i < fs.size(); i++) {
+            if (AYS_fixture_filter(fs[i], now, options.include_live)){
+                AYS_store_push(*store, fs[i]);
+                if (dedup) dedup->row_quotes.push_back(i);
+            }
+        }
     }
-    for (int worker = 0; worker < pairs; worker++ ){ // workers to tasks
-        for (int task = 0; task < pairs; task++ ){
-            int from = worker*2+1;
-            int to = task*2+2;
-            toNode = nodes[to];
-            fromNode = nodes[from];
-            arc = g.addArc(fromNode, toNode);
-            capacities[arc] = 1;
-            weights[arc] = weightMatrix[worker][task];
-            //std::cout << "edge: " << from << "->" << to << " @ " << weights[arc] << std::endl ;
-            arcs[arcIDX++] = arc;
+    std::vector<AYS_event> result = AYS_store_to_events(store, options);
+    if (dedup) dedup->row_quotes.clear();
+    return result;
+}
+
+std::vector<AYS_event> AYS_fixtures_to_events(std::vector<AYS_fixture> fs, bool includeLive, AYS_match_cache *cache = NULL, int threads = 1) {
+    return AYS_fixtures_to_events(std::move(fs), AYS_scan_options(includeLive, cache, threads));
+}
+
+/*
+ * Incremental engine.
+ * Holds the event book between calls, fixtures are upserted/removed by (pid, id) and only the
+ * events they touch are marked dirty, a fixture upserted again unchanged touches none (AYS_fixture_hash).
+ * AYS_engine_update re-runs AYS_event_arb on the dirty events and reports the ones whose roi crossed
+ * zero since the previous update.
+ * Clustering follows AYS_fixtures_to_events: a fixture joins the first event in its bucket whose
+ * participant names are within the 0.25 similarity cutoff, otherwise it starts a new event.
+ */
+struct AYS_engine_entry {
+    AYS_event_id event;
+    uint32_t pos; // index into events[event].fixtures
+    uint64_t hash; // AYS_fixture_hash of the fixture, 0 if not known
+};
+
+/*
+ * Time index of the engine, min-heaps of (expiry time, row) and (kickoff time, row) pushed when a row is stored or
+ * its times move. AYS_engine_update pops the entries that are due, so a tick costs O(due log n) instead of a pass
+ * over the book. Nothing is erased when a row is freed or requoted: a popped entry whose row left the book or whose
+ * time changed since is stale and dropped, and the heaps are rebuilt when stale entries outnumber the book.
+ */
+typedef std::pair<time_t, uint32_t> AYS_time_entry;
+
+struct AYS_time_index {
+    std::vector<AYS_time_entry> expiry;
+    std::vector<AYS_time_entry> kickoff; // without include_live only, fixtures leave the book when they start
+};
+
+void AYS_time_index_push(std::vector<AYS_time_entry> &heap, time_t t, uint32_t row){
+    heap.emplace_back(t, row);
+    std::push_heap(heap.begin(), heap.end(), std::greater<AYS_time_entry>());
+}
+
+// pops the entry at the top of the heap if it is due at now
+bool AYS_time_index_pop(std::vector<AYS_time_entry> &heap, time_t now, AYS_time_entry &entry){
+    if (heap.empty() || heap.front().first > now){
+        return false;
+    }
+    entry = heap.front();
+    std::pop_heap(heap.begin(), heap.end(), std::greater<AYS_time_entry>());
+    heap.pop_back();
+    return true;
+}
+
+struct AYS_engine {
+    bool include_live;
+    AYS_match_cache *cache; // optional, shared between engines/scans
+    const AYS_clock *clock; // time of the expiry and live filters, NULL for the default clock
+    std::shared_ptr<AYS_fixture_store> store;
+    std::vector<std::vector<uint32_t>> free_rows; // removed store rows by participant count
+    std::vector<AYS_event> events; // indexed by AYS_event_id, empty fixtures means free
+    // per event, the names of the fixture it was started with in the event's order. New fixtures are matched
+    // against them, so the matching of an event stays the same when that fixture leaves it
+    std::vector<std::vector<AYS_name_id>> anchors;
+    std::vector<float> last_roi; // roi as of the previous AYS_engine_update
+    std::vector<bool> dirty;
+    std::vector<AYS_event_id> dirty_events;
+    std::vector<AYS_event_id> free_events;
+    std::unordered_map<uint64_t, AYS_engine_entry> entries;
+    std::map<AYS_bucket_key, std::vector<AYS_event_id>> buckets;
+    AYS_time_index times;
+    AYS_arb_batch batch;
+    AYS_engine(bool include_live = false, AYS_match_cache *cache = NULL) 
+        : include_live(include_live)
+        , cache(cache)
+        , clock(NULL)
+        , store(std::make_shared<AYS_fixture_store>()) { }
+};
+
+uint64_t AYS_fixture_key(AYS_provider_id pid, AYS_fixture_id id){
+    return ((uint64_t)pid << 32) | id;
+}
+
+// whether row holds a fixture of the book, freed rows keep the (pid, id) of their last fixture
+bool AYS_engine_row_used(const AYS_engine &engine, uint32_t row){
+    const AYS_fixture_store &s = *engine.store;
+    auto it = engine.entries.find(AYS_fixture_key(s.pid[row], s.id[row]));
+    return it != engine.entries.end() && engine.events[it->second.event].fixtures[it->second.pos] == row;
+}
+
+void AYS_engine_index_row(AYS_engine &engine, uint32_t row){
+    const AYS_fixture_store &s = *engine.store;
+    AYS_time_index_push(engine.times.expiry, s.expiry_time[row], row);
+    if (!engine.include_live){
+        AYS_time_index_push(engine.times.kickoff, s.start_time[row], row);
+    }
+}
+
+// rebuilds the time index from the rows of the book
+void AYS_engine_index(AYS_engine &engine){
+    engine.times.expiry.clear();
+    engine.times.kickoff.clear();
+    for (auto& entry : engine.entries){
+        AYS_engine_index_row(engine, engine.events[entry.second.event].fixtures[entry.second.pos]);
+    }
+}
+
+void AYS_engine_mark_dirty(AYS_engine &engine, AYS_event_id eid){
+    if (!engine.dirty[eid]){
+        engine.dirty[eid] = true;
+        engine.dirty_events.push_back(eid);
+    }
+}
+
+uint32_t AYS_engine_store(AYS_engine &engine, const AYS_fixture &fixture){
+    size_t participants = fixture.participant_names.size();
+    if (participants < engine.free_rows.size() && engine.free_rows[participants].size() > 0){
+        uint32_t row = engine.free_rows[participants].back();
+        engine.free_rows[participants].pop_back();
+        AYS_store_set(*engine.store, row, fixture);
+        AYS_engine_index_row(engine, row);
+        return row;
+    }
+    uint32_t row = AYS_store_push(*engine.store, fixture);
+    AYS_engine_index_row(engine, row);
+    return row;
+}
+
+bool AYS_engine_remove(AYS_engine &engine, AYS_provider_id pid, AYS_fixture_id id){
+    auto it = engine.entries.find(AYS_fixture_key(pid, id));
+    if (it == engine.entries.end()){
+        return false;
+    }
+    AYS_event &event = engine.events[it->second.event];
+    uint32_t pos = it->second.pos;
+    uint32_t row = event.fixtures[pos];
+    int n = event.participants;
+    const AYS_fixture_store &s = *engine.store; // reads only, a mapped store stays mapped
+    if (pos == 0){ // in order, the oldest fixture left leads the event like in a scan
+        event.fixtures.erase(event.fixtures.begin());
+        event.slots.erase(event.slots.begin(), event.slots.begin()+n);
+        for (uint32_t p = 0; p < event.fixtures.size(); p++){
+            engine.entries[AYS_fixture_key(s.pid[event.fixtures[p]], s.id[event.fixtures[p]])].pos = p;
+        }
+    } else {
+        if (pos+1 < event.fixtures.size()){
+            event.fixtures[pos] = event.fixtures.back();
+            std::copy(event.slots.end()-n, event.slots.end(), event.slots.begin()+pos*n);
+            uint32_t moved = event.fixtures[pos];
+            engine.entries[AYS_fixture_key(s.pid[moved], s.id[moved])].pos = pos;
         }
+        event.fixtures.pop_back();
+        event.slots.resize(event.slots.size()-n);
+    }
+    if ((int)engine.free_rows.size() <= n){
+        engine.free_rows.resize(n+1);
     }
+    engine.free_rows[n].push_back(row);
+    AYS_engine_mark_dirty(engine, it->second.event);
+    engine.entries.erase(it);
+    return true;
+}
 
-    Graph::ArcMap<int32_t> flows(g);
-    MCF solver(g);
-    MCF::ProblemType status = solver.upperMap(capacities).costMap(weights).stSupply(sourceNode, sinkNode, pairs).run();
-    switch (status) 
-    {
-        case MCF::INFEASIBLE:
-            std::cerr << "insufficient flow" << std::endl;
-            return 1;
-        case MCF::OPTIMAL:
-            solver.flowMap(flows);
-            for (int worker = 0; worker < pairs; worker++ ){ // workers to tasks
-                for (int task = 0; task < pairs; task++ ){
-                    arc = arcs[pairs*2 + worker*pairs + task];
-                    if(flows[arc] != 0){
-                        solution[worker] = task;
-                    }
-                }
+bool AYS_engine_upsert(AYS_engine &engine, const AYS_fixture &fixture){
+    uint64_t key = AYS_fixture_key(fixture.pid, fixture.id);
+    if (!AYS_fixture_filter(fixture, AYS_now(engine.clock), engine.include_live)){
+        AYS_engine_remove(engine, fixture.pid, fixture.id);
+        return false;
+    }
+    uint64_t hash = AYS_fixture_hash(fixture);
+    auto it = engine.entries.find(key);
+    if (it != engine.entries.end() && it->second.hash == hash){ // a resend, the event stays as evaluated
+        return true;
+    }
+    const AYS_fixture_store &s = *engine.store;
+    int participants = fixture.participant_names.size();
+    AYS_bucket_key bkey = AYS_fixture_bucket_key(fixture);
+    std::vector<AYS_name_id> names(participants);
+    for (int j = 0; j < participants; j++){
+        names[j] = AYS_intern(AYS_names(), fixture.participant_names[j]);
+    }
+    if (it != engine.entries.end()){
+        AYS_engine_entry &entry = it->second;
+        uint32_t row = engine.events[entry.event].fixtures[entry.pos];
+        bool same = AYS_store_bucket_key(s, row) == bkey;
+        for (int j = 0; same && j < participants; j++){
+            same = s.participant_ids[s.offset[row]+j] == names[j];
+        }
+        if (same){ // only the odds moved, keep the matching
+            bool moved = s.expiry_time[row] != fixture.expiry_time || s.start_time[row] != fixture.start_time;
+            AYS_store_set(*engine.store, row, fixture);
+            if (moved){
+                AYS_engine_index_row(engine, row);
             }
-            break;
-        case MCF::UNBOUNDED:
-            std::cerr << "infinite flow" << std::endl;
-            return 2;
-        default:
-            break;
+            entry.hash = hash;
+            AYS_engine_mark_dirty(engine, entry.event);
+            return true;
+        }
+        AYS_engine_remove(engine, fixture.pid, fixture.id);
     }
-    return 0;
+
+    std::vector<AYS_event_id> &bucket = engine.buckets[bkey];
+    std::vector<int> sol;
+    for (AYS_event_id eid : bucket){
+        AYS_event &event = engine.events[eid]; // may have been emptied since the last update
+        float sim_score = similarity_sort(engine.anchors[eid].data(), names.data(), participants, &sol, engine.cache);
+        if (sim_score > 0.25){
+            AYS_STAT_ADD(threshold_rejections, 1);
+            continue;
+        }
+        // the anchor's names are in the event's order, so sol gives the slots
+        event.slots.insert(event.slots.end(), sol.begin(), sol.end());
+        engine.entries[key] = AYS_engine_entry{eid, (uint32_t)event.fixtures.size(), hash};
+        event.fixtures.push_back(AYS_engine_store(engine, fixture));
+        AYS_engine_mark_dirty(engine, eid);
+        return true;
+    }
+
+    AYS_arena_vector<uint32_t> fixtures(1, AYS_engine_store(engine, fixture));
+    AYS_arena_vector<uint8_t> slots(participants);
+    for (int j = 0; j < participants; j++){
+        slots[j] = j;
+    }
+    AYS_event_id eid;
+    if (engine.free_events.size() > 0){
+        eid = engine.free_events.back();
+        engine.free_events.pop_back();
+        engine.events[eid] = AYS_event(engine.store, fixtures, slots);
+        engine.anchors[eid] = names;
+        engine.last_roi[eid] = engine.events[eid].roi;
+    } else {
+        eid = engine.events.size();
+        engine.events.emplace_back(engine.store, fixtures, slots);
+        engine.anchors.push_back(names);
+        engine.last_roi.push_back(engine.events[eid].roi);
+        engine.dirty.push_back(false);
+    }
+    bucket.push_back(eid);
+    engine.entries[key] = AYS_engine_entry{eid, 0, hash};
+    AYS_engine_mark_dirty(engine, eid);
+    return true;
 }
 
+// removes the fixtures that expired, and without include_live the ones that started, by now
+void AYS_engine_expire(AYS_engine &engine, time_t now){
+    const AYS_fixture_store &s = *engine.store;
+    AYS_time_entry entry;
+    while (AYS_time_index_pop(engine.times.expiry, now, entry)){
+        if (s.expiry_time[entry.second] == entry.first && AYS_engine_row_used(engine, entry.second)){
+            AYS_STAT_ADD(fixtures_expired, 1);
+            AYS_engine_remove(engine, s.pid[entry.second], s.id[entry.second]);
+        }
+    }
+    while (AYS_time_index_pop(engine.times.kickoff, now, entry)){
+        if (s.start_time[entry.second] == entry.first && AYS_engine_row_used(engine, entry.second)){
+            AYS_STAT_ADD(fixtures_live, 1);
+            AYS_engine_remove(engine, s.pid[entry.second], s.id[entry.second]);
+        }
+    }
+    if (engine.times.expiry.size() + engine.times.kickoff.size() > 4*engine.entries.size() + 1024){
+        AYS_engine_index(engine);
+    }
+}
 
-float similarity_sort(const std::vector<std::string> &a1,const std::vector<std::string> &a2, std::vector<int> *solution){
-    if (a1.size() != a2.size()){
-        std::cerr << "different lengths a1:" <<a1.size() << " != a2:" << a2.size() << std::endl;
-        return 1.f;
+// drops the fixtures that are due (AYS_engine_expire) and re-runs the arb math on the dirty events, crossed gets
+// the events whose roi changed sign.
+// events emptied by removals are reported with roi -1 and their ids are recycled on the next upsert
+void AYS_engine_update(AYS_engine &engine, std::vector<AYS_event_id> &crossed){
+    AYS_engine_expire(engine, AYS_now(engine.clock));
+    std::vector<AYS_event_id> emptied;
+    AYS_arena_vector<uint32_t> evaluate;
+    for (AYS_event_id eid : engine.dirty_events){
+        AYS_event &event = engine.events[eid];
+        if (event.fixtures.size() == 0){
+            event.arb = std::numeric_limits<float>::infinity();
+            event.not_arb = std::numeric_limits<float>::infinity();
+            event.roi = -1;
+            emptied.push_back(eid);
+        } else {
+            evaluate.push_back(eid);
+        }
     }
-    int pairs = a1.size();
-    (*solution).resize(pairs);
-    std::vector<std::vector<int>> sim_matrix(pairs, std::vector<int> (pairs, 0)) ;
-    for (int i = 0; i<pairs; i++){
-        for (int j = 0; j<pairs; j++){
-            sim_matrix[i][j] = levenshteinSSE::levenshtein(a1[i], a2[j]);//https://stackoverflow.com/a/24063783   to lower?
+    AYS_events_arb(engine.events, engine.batch, &evaluate);
+    for (AYS_event_id eid : engine.dirty_events){
+        const AYS_event &event = engine.events[eid];
+        if ((engine.last_roi[eid] > 0) != (event.roi > 0)){
+            crossed.push_back(eid);
         }
+        engine.last_roi[eid] = event.roi;
+        engine.dirty[eid] = false;
     }
-    if (min_weight_matching(pairs, sim_matrix, *solution)){
-        return 1.f;
+    engine.dirty_events.clear();
+    for (AYS_event_id eid : emptied){
+        auto it = engine.buckets.find(AYS_event_bucket_key(engine.events[eid]));
+        it->second.erase(std::find(it->second.begin(), it->second.end(), eid));
+        if (it->second.size() == 0){
+            engine.buckets.erase(it);
+        }
+        engine.free_events.push_back(eid);
     }
-    float max = 0;
-    for (int i = 0; i<pairs; i++){
-        float x = (float)sim_matrix[i][(*solution)[i]]/((a1[i].size() + a2[i].size()) >>1);
-        if (x>max){
-            max = x;
+}
+
+// writes the fixtures of the engine's book, without the removed rows, as a snapshot (AYS_snapshot_write)
+bool AYS_engine_snapshot(const AYS_engine &engine, const std::string &path){
+    std::vector<uint32_t> rows;
+    for (auto& event : engine.events){
+        rows.insert(rows.end(), event.fixtures.begin(), event.fixtures.end());
+    }
+    std::sort(rows.begin(), rows.end());
+    return AYS_snapshot_write(*engine.store, path, &rows);
+}
+
+// replaces the book of the engine by a snapshot, the store views the mapped file and the fixtures are clustered
+// by a scan, the engine then holds the events that scan returns, none of them dirty. False if it cannot be read
+bool AYS_engine_load(AYS_engine &engine, const std::string &path){
+    std::shared_ptr<AYS_fixture_store> store = AYS_snapshot_load(path);
+    if (!store){
+        return false;
+    }
+    AYS_scan_options options(engine.include_live, engine.cache);
+    options.clock = engine.clock;
+    std::vector<AYS_event> events = AYS_store_to_events(store, options);
+    // the upserts try the events of a bucket in creation order, ie. by anchor row like the scan
+    std::sort(events.begin(), events.end(), [](const AYS_event &e1, const AYS_event &e2){ return e1.fixtures[0] < e2.fixtures[0]; });
+    engine.store = store;
+    engine.free_rows.clear();
+    engine.events = std::move(events);
+    engine.anchors.clear();
+    engine.last_roi.clear();
+    engine.dirty.assign(engine.events.size(), false);
+    engine.dirty_events.clear();
+    engine.free_events.clear();
+    engine.entries.clear();
+    engine.buckets.clear();
+    const AYS_fixture_store &s = *store;
+    std::vector<bool> used(AYS_store_size(s), false);
+    for (AYS_event_id eid = 0; eid < engine.events.size(); eid++){
+        const AYS_event &event = engine.events[eid];
+        for (uint32_t pos = 0; pos < event.fixtures.size(); pos++){
+            uint32_t row = event.fixtures[pos];
+            engine.entries[AYS_fixture_key(s.pid[row], s.id[row])] = AYS_engine_entry{eid, pos, 0};
+            used[row] = true;
+        }
+        engine.anchors.emplace_back(event.participants);
+        for (int j = 0; j < event.participants; j++){
+            engine.anchors.back()[j] = s.participant_ids[event.participant_idx(0, j)];
         }
+        engine.buckets[AYS_event_bucket_key(event)].push_back(eid);
+        engine.last_roi.push_back(event.roi);
     }
+    // expired and live fixtures are left out by the scan, their rows are reused
+    for (uint32_t row = 0; row < used.size(); row++){
+        if (used[row]) continue;
+        uint32_t n = AYS_store_participants(s, row);
+        if (engine.free_rows.size() <= n){
+            engine.free_rows.resize(n+1);
+        }
+        engine.free_rows[n].push_back(row);
+    }
+    AYS_engine_index(engine);
+    return true;
+}
 
-    return max; 
+
+/*
+ * Ingestion.
+ * Provider feeds push fixtures concurrently, each into its own bounded lock-free single producer single consumer
+ * ring (AYS_spsc_queue), so a feed never waits on another one. A full ring either drops the new quote (AYS_FEED_DROP,
+ * counted in dropped) or makes the producer wait for room (AYS_FEED_BLOCK, counted in blocked). AYS_ingest_poll
+ * takes at most budget fixtures from every feed in turn, keeps the latest quote per (pid, id), upserts those into the
+ * engine and updates it, so a burst on one noisy feed backs up in its own ring while the others go through on the
+ * next poll. AYS_ingest_start polls on its own thread every cadence. Feed sources replay a feed log or read one
+ * from a unix socket (path "unix:<socket>") into a feed, as stand-ins for the provider adapters.
+ */
+template<typename T>
+struct AYS_spsc_queue {
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type slot;
+    std::unique_ptr<slot[]> slots;
+    uint64_t mask;
+    std::atomic<uint64_t> head; // next slot to read, advanced by the consumer
+    char pad[64]; // keeps head and tail on their own cache lines
+    std::atomic<uint64_t> tail; // next slot to write, advanced by the producer
+    AYS_spsc_queue(uint32_t capacity) : head(0), tail(0) {
+        uint64_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots.reset(new slot[size]);
+        mask = size-1;
+    }
+    ~AYS_spsc_queue(){
+        for (uint64_t k = head.load(); k != tail.load(); k++){
+            ((T *)&slots[k & mask])->~T();
+        }
+    }
+};
+
+template<typename T>
+uint64_t AYS_queue_size(const AYS_spsc_queue<T> &queue){
+    return queue.tail.load(std::memory_order_acquire) - queue.head.load(std::memory_order_acquire);
+}
+
+// producer side, value is only moved from when there is room
+template<typename T>
+bool AYS_queue_push(AYS_spsc_queue<T> &queue, T &value){
+    uint64_t tail = queue.tail.load(std::memory_order_relaxed);
+    if (tail - queue.head.load(std::memory_order_acquire) > queue.mask){
+        return false;
+    }
+    new (&queue.slots[tail & queue.mask]) T(std::move(value));
+    queue.tail.store(tail+1, std::memory_order_release);
+    return true;
+}
+
+// consumer side, passes up to max values to take(T&) in order, returns how many
+template<typename T, typename F>
+uint64_t AYS_queue_drain(AYS_spsc_queue<T> &queue, uint64_t max, F take){
+    uint64_t head = queue.head.load(std::memory_order_relaxed);
+    uint64_t n = std::min(max, queue.tail.load(std::memory_order_acquire) - head);
+    for (uint64_t k = 0; k < n; k++){
+        T *value = (T *)&queue.slots[(head+k) & queue.mask];
+        take(*value);
+        value->~T();
+    }
+    queue.head.store(head+n, std::memory_order_release);
+    return n;
 }
 
-void split_on_diff(std::vector<AYS_fixture> fs, 
-                   std::vector<std::vector<AYS_fixture>> &out,
-                   std::vector<AYS_fixture_comparison_func> comps) {
-    if (fs.size() == 0) return;
-    for (auto& comp : comps){
-        std::stable_sort(fs.begin(), fs.end(), comp);
+enum AYS_backpressure {
+    AYS_FEED_DROP, // a full queue drops the new fixture
+    AYS_FEED_BLOCK // a full queue makes the producer wait
+};
+
+struct AYS_feed {
+    std::string name;
+    AYS_backpressure backpressure;
+    AYS_spsc_queue<AYS_fixture> queue;
+    std::atomic<uint64_t> pushed;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> blocked; // pushes that had to wait for room
+    std::atomic<bool> closed; // no more pushes, set by AYS_ingest_stop or when the source ends
+    std::thread source;
+    AYS_feed(const std::string &name, uint32_t capacity, AYS_backpressure backpressure)
+        : name(name)
+        , backpressure(backpressure)
+        , queue(capacity)
+        , pushed(0)
+        , dropped(0)
+        , blocked(0)
+        , closed(false) { }
+};
+
+// one producer per feed
+bool AYS_feed_push(AYS_feed &feed, AYS_fixture &fixture){
+    if (AYS_queue_push(feed.queue, fixture)){
+        feed.pushed.fetch_add(1, std::memory_order_relaxed);
+        return true;
     }
-    int start_idx = 0;
-    for (int idx = 0; idx < (int) fs.size(); idx++){
-        bool skip = true;
-        for (auto& comp : comps){
-            skip &= !comp(fs[idx], fs[start_idx]) and !comp(fs[start_idx], fs[idx]);
+    if (feed.backpressure == AYS_FEED_DROP){
+        feed.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    feed.blocked.fetch_add(1, std::memory_order_relaxed);
+    while (!AYS_queue_push(feed.queue, fixture)){
+        if (feed.closed.load(std::memory_order_relaxed)){
+            feed.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
         }
-        if (skip) {
-            continue;
+        std::this_thread::yield();
+    }
+    feed.pushed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+struct AYS_ingest {
+    AYS_engine *engine;
+    std::vector<std::unique_ptr<AYS_feed>> feeds; // added before AYS_ingest_start
+    uint32_t budget; // fixtures taken from a feed per poll
+    std::chrono::milliseconds cadence;
+    std::unordered_map<uint64_t, uint32_t> pending_index; // (pid, id) key to pending
+    std::vector<AYS_fixture> pending; // latest quote per key of a poll
+    std::vector<AYS_event_id> crossed;
+    std::thread thread;
+    std::atomic<bool> running;
+    std::function<void(AYS_engine &, const std::vector<AYS_event_id> &)> on_update; // after every poll that upserted
+    // counters, read them with AYS_ingest_stats
+    std::atomic<uint64_t> polls;
+    std::atomic<uint64_t> upserts;
+    std::atomic<uint64_t> coalesced; // quotes replaced by a later one of the same poll
+    std::atomic<uint64_t> poll_ns; // of the last poll
+    std::atomic<uint64_t> max_poll_ns;
+    AYS_ingest(AYS_engine &engine, uint32_t budget = 4096, std::chrono::milliseconds cadence = std::chrono::milliseconds(10))
+        : engine(&engine)
+        , budget(budget)
+        , cadence(cadence)
+        , running(false)
+        , polls(0)
+        , upserts(0)
+        , coalesced(0)
+        , poll_ns(0)
+        , max_poll_ns(0) { }
+    ~AYS_ingest();
+};
+
+AYS_feed &AYS_ingest_add_feed(AYS_ingest &ingest, const std::string &name, uint32_t capacity = 1 << 14, 
+                              AYS_backpressure backpressure = AYS_FEED_DROP){
+    ingest.feeds.emplace_back(new AYS_feed(name, capacity, backpressure));
+    return *ingest.feeds.back();
+}
+
+// one ingestion cycle on the calling thread, returns the fixtures upserted
+uint32_t AYS_ingest_poll(AYS_ingest &ingest){
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ingest.pending.clear();
+    ingest.pending_index.clear();
+    uint64_t coalesced = 0;
+    for (auto& feed : ingest.feeds){
+        AYS_queue_drain(feed->queue, ingest.budget, [&](AYS_fixture &fixture){
+            uint64_t key = AYS_fixture_key(fixture.pid, fixture.id);
+            auto it = ingest.pending_index.find(key);
+            if (it != ingest.pending_index.end()){
+                ingest.pending[it->second] = std::move(fixture);
+                coalesced++;
+            } else {
+                ingest.pending_index.emplace(key, ingest.pending.size());
+                ingest.pending.push_back(std::move(fixture));
+            }
+        });
+    }
+    for (auto& fixture : ingest.pending){
+        AYS_engine_upsert(*ingest.engine, fixture);
+    }
+    ingest.crossed.clear();
+    AYS_engine_update(*ingest.engine, ingest.crossed);
+    if (ingest.pending.size() > 0 && ingest.on_update){
+        ingest.on_update(*ingest.engine, ingest.crossed);
+    }
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+    ingest.polls.fetch_add(1, std::memory_order_relaxed);
+    ingest.upserts.fetch_add(ingest.pending.size(), std::memory_order_relaxed);
+    ingest.coalesced.fetch_add(coalesced, std::memory_order_relaxed);
+    ingest.poll_ns.store(ns, std::memory_order_relaxed);
+    if (ns > ingest.max_poll_ns.load(std::memory_order_relaxed)){
+        ingest.max_poll_ns.store(ns, std::memory_order_relaxed);
+    }
+    return ingest.pending.size();
+}
+
+// polls every cadence on a thread of its own, the engine then belongs to that thread (and on_update) until
+// AYS_ingest_stop
+void AYS_ingest_start(AYS_ingest &ingest){
+    ingest.running = true;
+    ingest.thread = std::thread([&ingest](){
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+        while (ingest.running.load(std::memory_order_relaxed)){
+            AYS_ingest_poll(ingest);
+            next = std::max(next + ingest.cadence, std::chrono::steady_clock::now()); // a slow poll does not queue up polls
+            std::this_thread::sleep_until(next);
         }
-        std::vector<AYS_fixture> group(fs.begin()+start_idx, fs.begin()+idx);
-        out.emplace_back(group);
-        start_idx = idx;
+    });
+}
+
+// closes the feeds and stops the sources and the polling thread
+void AYS_ingest_join(AYS_ingest &ingest){
+    for (auto& feed : ingest.feeds){
+        feed->closed = true;
     }
-    if(fs.begin()+start_idx < fs.end()) {
-        std::vector<AYS_fixture> group(fs.begin()+start_idx, fs.end());
-        out.emplace_back(group);
+    for (auto& feed : ingest.feeds){
+        if (feed->source.joinable()) feed->source.join();
+    }
+    ingest.running = false;
+    if (ingest.thread.joinable()){
+        ingest.thread.join();
     }
 }
 
-std::vector<AYS_event> AYS_fixtures_to_events(std::vector<AYS_fixture> fs, bool includeLive) {
-    std::vector<AYS_event> result;
-    if (fs.size() == 0){
-        return result;
-    }
-    time_t now = std::time(0);
-    std::vector<AYS_fixture> filtered_fs;
-    filtered_fs.reserve(fs.size());
-    for (auto& fixture : fs) {
-        if (difftime(fixture.expiry_time, now) > 0 ){
-            if (includeLive || difftime(fixture.start_time, now) > 0){
-                if (fixture.participant_names.size()<=3){
-                    filtered_fs.push_back(fixture);
-                }
-            } 
+// stops the ingestion and upserts what the feeds still hold. With wait_sources the sources first run to the end
+// of their logs, otherwise they stop at once
+void AYS_ingest_stop(AYS_ingest &ingest, bool wait_sources = false){
+    for (auto& feed : ingest.feeds){
+        while (wait_sources && feed->source.joinable() && !feed->closed.load()){
+            if (ingest.running){
+                std::this_thread::sleep_for(ingest.cadence);
+            } else { // blocked sources wait for room
+                AYS_ingest_poll(ingest);
+            }
         }
     }
-    fs = filtered_fs;
-
-    std::vector<std::vector<AYS_fixture>> fixture_groups;
-    split_on_diff(fs, fixture_groups, {AYS_start_time_compare, AYS_btid_compare, AYS_sid_compare, AYS_participant_number_compare, AYS_line_compare});
-    while (fixture_groups.size() > 0) { 
-        std::vector<std::vector<AYS_fixture>> dissimilar_fixture_groups;
-        for (std::vector<AYS_fixture> group : fixture_groups){
-            std::vector<AYS_fixture> dissimilar_fixtures;
-            std::vector<AYS_fixture> similar_fixtures;
-            AYS_fixture f = group[0];
-            for (int i = 1; i < (int)group.size(); i++){
-                std::vector<int> sol;
-                float sim_score = similarity_sort(f.participant_names, group[i].participant_names, &sol);
-                if (sim_score > 0.25){
-                    dissimilar_fixtures.emplace_back(group[i]);
-                    continue;
-                }
-                for (int j = 0; j<(int)sol.size(); j++){
-                    if (sol[j] < j){
-                        std::swap(group[i].participant_names[j], group[i].participant_names[sol[j]]);
-                        std::swap(group[i].participant_odds[j], group[i].participant_odds[sol[j]]);
-                        std::swap(group[i].participant_not_odds[j], group[i].participant_not_odds[sol[j]]);
-                    }
-                }
-                similar_fixtures.emplace_back(group[i]);
+    AYS_ingest_join(ingest);
+    while (AYS_ingest_poll(ingest) > 0);
+}
+
+// the engine may be gone by now, the threads are stopped without a last poll
+AYS_ingest::~AYS_ingest(){
+    AYS_ingest_join(*this);
+}
+
+// pushes the fixtures of a feed log, or of the log streamed by the unix socket of a "unix:<socket>" path, into the
+// feed on a thread of its own. The feed is closed at the end of the log
+bool AYS_feed_source_start(AYS_feed &feed, const std::string &path){
+    std::shared_ptr<AYS_feed_reader> reader = std::make_shared<AYS_feed_reader>();
+#ifndef _WIN32
+    if (path.compare(0, 5, "unix:") == 0){
+        if (!AYS_reader_connect(*reader, path.substr(5))) return false;
+    } else
+#endif
+    if (!AYS_reader_open(*reader, path)) return false;
+    feed.source = std::thread([&feed, reader](){
+        AYS_feed_batch batch;
+        while (!feed.closed.load(std::memory_order_relaxed) && AYS_feed_next(*reader, batch)){
+            for (auto& fixture : batch.fixtures){
+                AYS_feed_push(feed, fixture);
             }
-            similar_fixtures.emplace_back(f);
-            result.emplace_back(similar_fixtures);
-            if (dissimilar_fixtures.size()> 0){
-                dissimilar_fixture_groups.emplace_back(dissimilar_fixtures);
+        }
+        feed.closed = true;
+    });
+    return true;
+}
+
+std::string AYS_ingest_stats(const AYS_ingest &ingest){
+    std::string result = fmt::format("{{\"polls\":{},\"upserts\":{},\"coalesced\":{},\"poll_ns\":{},\"max_poll_ns\":{},\"feeds\":[",
+                                     ingest.polls.load(), ingest.upserts.load(), ingest.coalesced.load(), ingest.poll_ns.load(), 
+                                     ingest.max_poll_ns.load());
+    for (size_t f = 0; f < ingest.feeds.size(); f++){
+        const AYS_feed &feed = *ingest.feeds[f];
+        result += fmt::format("{}{{\"name\":\"{}\",\"pushed\":{},\"dropped\":{},\"blocked\":{},\"queued\":{}}}", f ? "," : "", feed.name, 
+                              feed.pushed.load(), feed.dropped.load(), feed.blocked.load(), AYS_queue_size(feed.queue));
+    }
+    return result + "]}";
+}
+
+#ifndef _WIN32
+/*
+ * Sharding.
+ * Buckets (AYS_bucket_key) never share an event, so the book can be split between processes along any function of
+ * the bucket key without changing the events found. AYS_shard_map routes on cells of (sid, kickoff window), a cell
+ * goes to the shard its hash picks unless AYS_shard_rebalance pinned it to another one. A worker process
+ * (AYS_shard_serve) reads books from a unix socket as a feed log, so a name crosses the socket once per connection,
+ * scans each at the clock it was sent with and answers with a header of uint32 events and uint32 bytes followed by
+ * its events in the binary format of AYS_event_writer, highest roi first. AYS_shard_scan sends every shard its slice
+ * of a book, then merges the answers by roi. Before routing it counts the fixtures per cell and, while a shard holds
+ * more than (1+slack) times the mean, moves the cell that best evens it out to the least loaded shard. Workers keep
+ * no book between scans, so a moved cell moves no state. A cell is never split, one hot window of one sport stays on
+ * one shard and the rest of its shard's cells move away from it.
+ */
+#define AYS_BINARY_ROI_OFFSET 32 // of roi in an AYS_OUTPUT_BINARY record
+
+struct AYS_shard_map {
+    uint32_t shards;
+    int64_t window; // seconds of a kickoff window
+    float slack;
+    std::unordered_map<uint64_t, uint32_t> pinned; // cell to shard
+    std::unordered_map<uint64_t, uint64_t> load; // fixtures per cell of the last book
+    std::vector<uint64_t> shard_load; // of the last book
+    uint64_t moves;
+    AYS_shard_map(uint32_t shards, int64_t window = 3600, float slack = 0.25) 
+        : shards(std::max<uint32_t>(1, shards))
+        , window(std::max<int64_t>(1, window))
+        , slack(slack)
+        , moves(0) { }
+};
+
+uint64_t AYS_shard_cell(const AYS_shard_map &map, AYS_sport_id sid, time_t start_time){
+    int64_t w = (int64_t)start_time / map.window;
+    return ((uint64_t)sid << 32) | (uint32_t)w;
+}
+
+uint32_t AYS_shard_of(const AYS_shard_map &map, uint64_t cell){
+    auto it = map.pinned.find(cell);
+    if (it != map.pinned.end()){
+        return it->second;
+    }
+    return ((cell * 0x9E3779B97F4A7C15ull) >> 32) % map.shards;
+}
+
+void AYS_shard_measure(AYS_shard_map &map, const std::vector<AYS_fixture> &book){
+    map.load.clear();
+    for (auto& f : book){
+        map.load[AYS_shard_cell(map, f.sid, f.start_time)]++;
+    }
+}
+
+// moves cells off the most loaded shard while it holds more than (1+slack) times the mean, returns the cells moved.
+// Pins of cells the last book did not have are dropped
+uint32_t AYS_shard_rebalance(AYS_shard_map &map){
+    for (auto it = map.pinned.begin(); it != map.pinned.end();){
+        it = map.load.count(it->first) ? std::next(it) : map.pinned.erase(it);
+    }
+    map.shard_load.assign(map.shards, 0);
+    std::vector<std::vector<std::pair<uint64_t, uint64_t>>> cells(map.shards); // (load, cell)
+    uint64_t total = 0;
+    for (auto& c : map.load){
+        uint32_t shard = AYS_shard_of(map, c.first);
+        map.shard_load[shard] += c.second;
+        cells[shard].emplace_back(c.second, c.first);
+        total += c.second;
+    }
+    double limit = (1 + map.slack)*total/map.shards;
+    uint32_t moved = 0;
+    for (size_t step = 0; step < map.load.size(); step++){
+        uint32_t hi = std::max_element(map.shard_load.begin(), map.shard_load.end()) - map.shard_load.begin();
+        uint32_t lo = std::min_element(map.shard_load.begin(), map.shard_load.end()) - map.shard_load.begin();
+        if (map.shard_load[hi] <= limit){
+            break;
+        }
+        // a cell lighter than the gap lowers the maximum, the one closest to half the gap evens out the pair best
+        uint64_t gap = map.shard_load[hi] - map.shard_load[lo];
+        size_t best = cells[hi].size();
+        for (size_t k = 0; k < cells[hi].size(); k++){
+            uint64_t c = cells[hi][k].first;
+            if (c < gap && (best == cells[hi].size() || std::llabs((int64_t)(2*c) - (int64_t)gap) < std::llabs((int64_t)(2*cells[hi][best].first) - (int64_t)gap))){
+                best = k;
             }
         }
-        fixture_groups = std::move(dissimilar_fixture_groups);         
-    }  
-    for (auto& event : result) {
-        AYS_event_arb(event);
+        if (best == cells[hi].size()){
+            break;
+        }
+        std::pair<uint64_t, uint64_t> cell = cells[hi][best];
+        cells[hi][best] = cells[hi].back();
+        cells[hi].pop_back();
+        cells[lo].push_back(cell);
+        map.shard_load[hi] -= cell.first;
+        map.shard_load[lo] += cell.first;
+        map.pinned[cell.second] = lo;
+        moved++;
+    }
+    map.moves += moved;
+    return moved;
+}
+
+// reads exactly size bytes
+bool AYS_read_full(int fd, char *data, size_t size){
+    while (size > 0){
+        ssize_t n = read(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// serves one coordinator connection accepted on listen_fd until the coordinator closes it, false if the connection
+// failed. The books are scanned with options at the clock they were sent with
+bool AYS_shard_serve(int listen_fd, AYS_scan_options options){
+    int fd;
+    do {
+        fd = accept(listen_fd, NULL, NULL);
+    } while (fd < 0 && errno == EINTR);
+    int out = fd >= 0 ? dup(fd) : -1;
+    if (out < 0){
+        std::cerr << "could not accept a coordinator" << std::endl;
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    AYS_feed_reader reader;
+    if (!AYS_reader_fdopen(reader, fd)){
+        close(out);
+        return false;
+    }
+    AYS_clock clock;
+    options.clock = &clock;
+    options.recorder = NULL;
+    AYS_event_writer writer(out, AYS_OUTPUT_BINARY, std::numeric_limits<size_t>::max()); // one write per answer
+    AYS_feed_batch batch;
+    bool ok = true;
+    while (ok && AYS_feed_next(reader, batch)){
+        AYS_clock_set(clock, batch.clock);
+        std::vector<AYS_event> events = AYS_fixtures_to_events(std::move(batch.fixtures), options);
+        batch.fixtures.clear();
+        AYS_binary_put<uint32_t>(writer.buffer, events.size());
+        AYS_binary_put<uint32_t>(writer.buffer, 0); // patched below
+        for (auto it = events.rbegin(); it != events.rend(); ++it){
+            AYS_writer_append(writer, *it);
+        }
+        AYS_binary_store<uint32_t>(writer.buffer.data() + sizeof(uint32_t), writer.buffer.size() - 2*sizeof(uint32_t));
+        ok = AYS_writer_flush(writer);
     }
+    close(out);
+    return ok;
+}
 
-    std::sort(result.begin(), result.end(), AYS_roi_compare);
-    return result;
+struct AYS_shard_link {
+    int fd; // answers are read from it, the recorder sends the books on a dup of it
+    AYS_feed_recorder recorder;
+    std::vector<uint32_t> routed; // book index of the fixtures sent
+    std::string answer;
+    std::vector<uint32_t> records; // offsets in answer
+    AYS_shard_link() : fd(-1) { }
+    ~AYS_shard_link(){
+        if (fd >= 0) close(fd);
+    }
+};
+
+struct AYS_shard_coordinator {
+    AYS_shard_map map;
+    bool rebalance;
+    std::vector<std::unique_ptr<AYS_shard_link>> links;
+    AYS_shard_coordinator(int64_t window = 3600, float slack = 0.25) : map(1, window, slack), rebalance(true) { }
+};
+
+// connects to one worker per socket path, the shards of the map
+bool AYS_shard_connect(AYS_shard_coordinator &coordinator, const std::vector<std::string> &paths){
+    coordinator.links.clear();
+    for (auto& path : paths){
+        std::unique_ptr<AYS_shard_link> link(new AYS_shard_link());
+        link->fd = AYS_unix_connect(path);
+        int out = link->fd >= 0 ? dup(link->fd) : -1;
+        if (out < 0 || !AYS_recorder_fdopen(link->recorder, out)){
+            coordinator.links.clear();
+            return false;
+        }
+        coordinator.links.push_back(std::move(link));
+    }
+    coordinator.map.shards = std::max<size_t>(1, paths.size());
+    coordinator.map.pinned.clear();
+    return paths.size() > 0;
 }
 
+// scans book on the shards as of now. out gets the events of all shards by descending roi in the binary format of
+// AYS_event_writer, returns their number or -1 if a shard failed, the shards then need AYS_shard_connect again
+int64_t AYS_shard_scan(AYS_shard_coordinator &coordinator, const std::vector<AYS_fixture> &book, time_t now, fmt::memory_buffer &out){
+    AYS_shard_map &map = coordinator.map;
+    AYS_shard_measure(map, book);
+    if (coordinator.rebalance){
+        AYS_shard_rebalance(map);
+    }
+    for (auto& link : coordinator.links){
+        link->routed.clear();
+    }
+    for (uint32_t i = 0; i < book.size(); i++){
+        const AYS_fixture &f = book[i];
+        coordinator.links[AYS_shard_of(map, AYS_shard_cell(map, f.sid, f.start_time))]->routed.push_back(i);
+    }
+    bool ok = true;
+    for (auto& link : coordinator.links){ // all shards scan at once
+        ok = AYS_recorder_append_with(link->recorder, link->routed.size(), now, 
+                                      [&](size_t k) -> const AYS_fixture & { return book[link->routed[k]]; }) && ok;
+    }
+    typedef std::pair<float, uint32_t> AYS_shard_head; // (roi, link) of the next record of a link
+    std::priority_queue<AYS_shard_head> heads;
+    std::vector<size_t> next(coordinator.links.size(), 0);
+    for (uint32_t l = 0; ok && l < coordinator.links.size(); l++){
+        AYS_shard_link &link = *coordinator.links[l];
+        char header[2*sizeof(uint32_t)];
+        ok = AYS_read_full(link.fd, header, sizeof(header));
+        uint32_t records = ok ? AYS_binary_load<uint32_t>(header) : 0;
+        uint32_t bytes = ok ? AYS_binary_load<uint32_t>(header + sizeof(uint32_t)) : 0;
+        link.answer.resize(bytes);
+        ok = ok && AYS_read_full(link.fd, &link.answer[0], bytes);
+        link.records.clear();
+        for (size_t pos = 0; ok && pos < link.answer.size();){
+            uint16_t size = pos + sizeof(uint16_t) <= link.answer.size() ? AYS_binary_load<uint16_t>(&link.answer[pos]) : 0;
+            ok = size >= AYS_BINARY_ROI_OFFSET + sizeof(float) && pos + size <= link.answer.size();
+            link.records.push_back(pos);
+            pos += size;
+        }
+        ok = ok && link.records.size() == records;
+        if (ok && link.records.size() > 0){
+            heads.push(AYS_shard_head(AYS_binary_load<float>(&link.answer[link.records[0] + AYS_BINARY_ROI_OFFSET]), l));
+        }
+    }
+    if (!ok){
+        std::cerr << "a shard failed" << std::endl;
+        return -1;
+    }
+    int64_t events = 0;
+    while (!heads.empty()){
+        uint32_t l = heads.top().second;
+        heads.pop();
+        AYS_shard_link &link = *coordinator.links[l];
+        const char *record = &link.answer[link.records[next[l]]];
+        out.append(record, record + AYS_binary_load<uint16_t>(record));
+        events++;
+        if (++next[l] < link.records.size()){
+            heads.push(AYS_shard_head(AYS_binary_load<float>(&link.answer[link.records[next[l]] + AYS_BINARY_ROI_OFFSET]), l));
+        }
+    }
+    return events;
+}
+#endif
 
 #endif
@@ -0,0 +1,130 @@
+#ifndef ARE_YOU_SURE_H
+#define ARE_YOU_SURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * C interface of the shared library libare_you_sure (are_you_sure_c.cpp, see build.sh), for callers in other
+ * languages and runtimes. Only the functions and structs below are exported, the C++ API stays internal.
+ * Fixtures go in as flat arrays owned by the caller (ays_fixtures), a scan writes them straight into the columnar
+ * store without building an AYS_fixture per fixture. Results come back in arrays of ays_event the caller allocated.
+ * Names and currencies can be passed as C strings or as ids from ays_intern_name/ays_intern_currency, which skip
+ * the string hashing for names the caller has seen before. Ids are valid for the life of the process.
+ * Odds are inverse decimal odds (1/decimal, 1 for no price) like AYS_fixture's, the legs of the results carry
+ * decimal odds. A handle is used by one thread at a time, different handles and the interning are thread safe.
+ * Functions returning a count return -1 for invalid arguments, with the reason on stderr.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef _WIN32
+#define AYS_API __declspec(dllexport)
+#else
+#define AYS_API __attribute__((visibility("default")))
+#endif
+
+#define AYS_ABI_VERSION 1
+
+// fixture i has the participants [offset[i], offset[i+1]) of the participant arrays, the arrays are only read
+// during the call
+typedef struct ays_fixtures {
+    uint32_t count;
+    const int64_t *start_time;
+    const int64_t *expiry_time;
+    const uint32_t *pid;
+    const uint32_t *id;
+    const uint32_t *sid;
+    const uint32_t *btid;
+    const int32_t *line;
+    const float *max_nominal_bet;
+    const char *const *currency; // NUL terminated, or NULL to use currency_ids
+    const uint32_t *currency_ids;
+    const uint32_t *offset; // count+1 entries starting at 0
+    const char *const *participant_names; // NUL terminated, or NULL to use participant_ids
+    const uint32_t *participant_ids;
+    const float *participant_odds; // inverse odds of the participant winning
+    const float *participant_not_odds; // inverse odds of the participant not winning
+} ays_fixtures;
+
+// the best fixture of a side that is bet on
+typedef struct ays_leg {
+    uint32_t pid;
+    uint32_t id;
+    float odds; // decimal
+    float stake;
+    float max_bet;
+    uint32_t currency; // ays_currency
+    uint8_t participant;
+    uint8_t side; // 0 the participant wins, 1 it does not
+    uint16_t reserved;
+} ays_leg;
+
+typedef struct ays_event {
+    int64_t start_time;
+    uint32_t event_id; // of the engine, the rank in a scan
+    uint32_t sid;
+    uint32_t btid;
+    int32_t line;
+    float arb;
+    float not_arb;
+    float roi; // -1 for engine events whose fixtures were all removed
+    float profit;
+    uint32_t fixtures;
+    uint32_t participant_names[3]; // ays_name, indexed by ays_leg::participant
+    uint8_t kind; // 0 arb, 1 not_arb
+    uint8_t participants;
+    uint8_t legs;
+    uint8_t reserved;
+    ays_leg leg[3];
+} ays_event;
+
+typedef struct ays_options {
+    int include_live; // keep the fixtures that started
+    int threads; // of the scan
+    float min_roi; // events below are not returned
+    int64_t now; // time of the expiry and live filters, 0 for the wall clock
+} ays_options;
+
+typedef struct ays_scanner ays_scanner;
+typedef struct ays_engine ays_engine;
+
+AYS_API int ays_abi_version(void);
+// defaults: no live fixtures, 1 thread, every roi, the wall clock
+AYS_API void ays_options_init(ays_options *options);
+
+// the id of the string, UINT32_MAX if it is NULL or could not be interned
+AYS_API uint32_t ays_intern_name(const char *name);
+AYS_API uint32_t ays_intern_currency(const char *currency);
+AYS_API const char *ays_name(uint32_t name);
+AYS_API const char *ays_currency(uint32_t currency);
+
+// a scanner keeps its store and scratch memory between scans, options may be NULL for the defaults
+AYS_API ays_scanner *ays_scanner_new(const ays_options *options);
+AYS_API void ays_scanner_free(ays_scanner *scanner);
+AYS_API void ays_scanner_set_time(ays_scanner *scanner, int64_t now);
+// scans the batch and writes the events with roi >= min_roi into events, at most capacity of them with the
+// highest roi first. Returns the number written
+AYS_API int64_t ays_scan(ays_scanner *scanner, const ays_fixtures *batch, ays_event *events, uint32_t capacity);
+
+// an incremental engine (AYS_engine), options may be NULL for the defaults
+AYS_API ays_engine *ays_engine_new(const ays_options *options);
+AYS_API void ays_engine_free(ays_engine *engine);
+AYS_API void ays_engine_set_time(ays_engine *engine, int64_t now);
+// upserts the fixtures by (pid, id), returns how many are in the book, the others were filtered out and removed
+AYS_API int64_t ays_engine_upsert(ays_engine *engine, const ays_fixtures *batch);
+// returns 1 if the fixture was in the book
+AYS_API int ays_engine_remove(ays_engine *engine, uint32_t pid, uint32_t id);
+// re-evaluates the events touched since the last update and writes the ones whose roi changed sign into crossed.
+// Returns how many crossed, which can be more than capacity
+AYS_API int64_t ays_engine_update(ays_engine *engine, ays_event *crossed, uint32_t capacity);
+// writes the events of the book with roi >= min_roi, at most capacity of them with the highest roi first.
+// Returns the number written
+AYS_API int64_t ays_engine_events(ays_engine *engine, ays_event *events, uint32_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
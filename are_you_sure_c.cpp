@@ -0,0 +1,372 @@
+#include "are_you_sure.cpp"
+#include "are_you_sure.h"
+
+/*
+ * The C interface of are_you_sure.h, built into libare_you_sure.so with -fvisibility=hidden and the version script
+ * are_you_sure.map so that only the ays_ functions are exported, the visibility alone still exports the libstdc++
+ * templates the library instantiates. A scan copies the caller's arrays column by column into a store the scanner
+ * keeps between scans (AYS_store_clear), the engine upserts through one reused AYS_fixture whose strings and vectors
+ * keep their capacity. No exception leaves the library, a failed call returns -1 (NULL for the constructors,
+ * UINT32_MAX for the intern functions).
+ */
+struct ays_scanner {
+    AYS_scan_options options;
+    AYS_clock clock;
+    AYS_scan_arena arena;
+    std::shared_ptr<AYS_fixture_store> store;
+    AYS_legs legs;
+    ays_scanner() : store(std::make_shared<AYS_fixture_store>()) { }
+};
+
+struct ays_engine {
+    AYS_engine engine;
+    AYS_clock clock;
+    float min_roi;
+    AYS_fixture fixture; // upserted row, reused
+    std::vector<AYS_event_id> crossed;
+    std::vector<AYS_event_id> ranked;
+    AYS_legs legs;
+    ays_engine(bool include_live, float min_roi, std::vector<AYS_participant> names = {}, std::vector<AYS_odd> odds = {})
+        : engine(include_live)
+        , min_roi(min_roi)
+        , fixture(0, 0, 0, 0, 0, 0, 0, "", 0, names, odds, odds) { }
+};
+
+// call() or failed if it throws
+template<typename R, typename F>
+R AYS_capi_call(const char *function, R failed, F call){
+    try {
+        return call();
+    } catch (const std::exception &e){
+        std::cerr << function << ": " << e.what() << std::endl;
+        return failed;
+    }
+}
+
+template<typename F>
+int64_t AYS_capi_call(const char *function, F call){
+    return AYS_capi_call(function, (int64_t)-1, call);
+}
+
+uint32_t AYS_capi_interned(AYS_intern_table &table){
+    std::lock_guard<std::mutex> guard(table.lock);
+    return table.size;
+}
+
+bool AYS_capi_ids_valid(AYS_intern_table &table, const uint32_t *ids, size_t n){
+    uint32_t size = AYS_capi_interned(table);
+    for (size_t i = 0; i < n; i++){
+        if (ids[i] >= size) return false;
+    }
+    return true;
+}
+
+bool AYS_capi_check(const char *function, const ays_fixtures *batch){
+    const char *error = NULL;
+    if (batch == NULL){
+        error = "no batch";
+    } else if (batch->count > 0 && (!batch->start_time || !batch->expiry_time || !batch->pid || !batch->id || !batch->sid ||
+                                      !batch->btid || !batch->line || !batch->max_nominal_bet || !batch->offset)){
+        error = "missing fixture array";
+    } else if (batch->count > 0 && !batch->currency && !batch->currency_ids){
+        error = "no currency or currency_ids";
+    } else if (batch->offset && batch->offset[0] != 0){
+        error = "offset[0] is not 0";
+    }
+    for (uint32_t i = 0; error == NULL && i < batch->count; i++){
+        if (batch->offset[i+1] < batch->offset[i]){
+            error = "offsets decrease";
+        } else if (batch->offset[i+1] - batch->offset[i] > 255){
+            error = "more than 255 participants";
+        } else if (batch->currency && !batch->currency[i]){
+            error = "NULL currency";
+        }
+    }
+    size_t participants = batch && batch->count > 0 ? batch->offset[batch->count] : 0;
+    if (error == NULL && participants > 0){
+        if (!batch->participant_odds || !batch->participant_not_odds){
+            error = "missing odds array";
+        } else if (!batch->participant_names && !batch->participant_ids){
+            error = "no participant_names or participant_ids";
+        } else if (!batch->participant_names && !AYS_capi_ids_valid(AYS_names(), batch->participant_ids, participants)){
+            error = "unknown participant id";
+        }
+        for (size_t k = 0; error == NULL && batch->participant_names && k < participants; k++){
+            if (!batch->participant_names[k]) error = "NULL participant name";
+        }
+    }
+    if (error == NULL && batch->count > 0 && !batch->currency && !AYS_capi_ids_valid(AYS_currencies(), batch->currency_ids, batch->count)){
+        error = "unknown currency id";
+    }
+    if (error){
+        std::cerr << function << ": " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// appends the batch to the store column by column
+void AYS_capi_store(AYS_fixture_store &store, const ays_fixtures &batch){
+    size_t participants = batch.count > 0 ? batch.offset[batch.count] : 0;
+    AYS_store_reserve(store, AYS_store_size(store) + batch.count, store.participant_ids.size() + participants);
+    uint32_t base = store.participant_ids.size();
+    for (uint32_t i = 0; i < batch.count; i++){
+        store.start_time.push_back(batch.start_time[i]);
+        store.expiry_time.push_back(batch.expiry_time[i]);
+        store.pid.push_back(batch.pid[i]);
+        store.id.push_back(batch.id[i]);
+        store.sid.push_back(batch.sid[i]);
+        store.btid.push_back(batch.btid[i]);
+        store.line.push_back(batch.line[i]);
+        store.max_nominal_bet.push_back(batch.max_nominal_bet[i]);
+        store.currency.push_back(batch.currency ? AYS_intern(AYS_currencies(), batch.currency[i]) : batch.currency_ids[i]);
+        store.offset.push_back(base + batch.offset[i+1]);
+    }
+    for (size_t k = 0; k < participants; k++){
+        store.participant_ids.push_back(batch.participant_names ? AYS_intern(AYS_names(), batch.participant_names[k]) : batch.participant_ids[k]);
+        store.participant_not_odds.push_back(AYS_odds_quantize(batch.participant_not_odds[k]));
+        store.participant_odds.push_back(AYS_odds_quantize(batch.participant_odds[k]));
+    }
+}
+
+// overwrites fixture with fixture i of the batch, in the capacity it already has
+void AYS_capi_fixture(const ays_fixtures &batch, uint32_t i, AYS_fixture &fixture){
+    fixture.start_time = batch.start_time[i];
+    fixture.expiry_time = batch.expiry_time[i];
+    fixture.pid = batch.pid[i];
+    fixture.id = batch.id[i];
+    fixture.sid = batch.sid[i];
+    fixture.btid = batch.btid[i];
+    fixture.line = batch.line[i];
+    fixture.max_nominal_bet = batch.max_nominal_bet[i];
+    if (batch.currency){
+        fixture.currency.assign(batch.currency[i]);
+    } else {
+        fixture.currency.assign(AYS_currency(batch.currency_ids[i]));
+    }
+    uint32_t o = batch.offset[i];
+    uint32_t participants = batch.offset[i+1] - o;
+    fixture.participant_names.resize(participants);
+    fixture.participant_odds.assign(batch.participant_odds + o, batch.participant_odds + o + participants);
+    fixture.participant_not_odds.assign(batch.participant_not_odds + o, batch.participant_not_odds + o + participants);
+    for (uint32_t j = 0; j < participants; j++){
+        if (batch.participant_names){
+            fixture.participant_names[j].assign(batch.participant_names[o+j]);
+        } else {
+            fixture.participant_names[j].assign(AYS_name(batch.participant_ids[o+j]));
+        }
+    }
+}
+
+// the event with its legs, the legs need the arb of the event evaluated
+void AYS_capi_event(const AYS_event &event, uint32_t event_id, AYS_legs &legs, ays_event &out){
+    memset(&out, 0, sizeof(out));
+    out.start_time = event.start_time;
+    out.event_id = event_id;
+    out.sid = event.sid;
+    out.btid = event.btid;
+    out.line = event.line;
+    out.arb = event.arb;
+    out.not_arb = event.not_arb;
+    out.roi = event.roi;
+    out.fixtures = event.fixtures.size();
+    out.kind = event.arb <= event.not_arb ? 0 : 1;
+    out.participants = event.participants;
+    if (event.fixtures.size() == 0){
+        return;
+    }
+    for (int j = 0; j < event.participants && j < 3; j++){
+        out.participant_names[j] = event.name_id(0, j);
+    }
+    AYS_event_legs(event, legs);
+    const AYS_fixture_store &s = *event.store;
+    out.profit = legs.profit;
+    out.legs = legs.count;
+    for (int l = 0; l < legs.count; l++){
+        uint32_t row = event.fixtures[legs.fixture[l]];
+        ays_leg &leg = out.leg[l];
+        leg.pid = s.pid[row];
+        leg.id = s.id[row];
+        leg.odds = 1/legs.odds[l];
+        leg.stake = legs.stakes[l];
+        leg.max_bet = s.max_nominal_bet[row];
+        leg.currency = s.currency[row];
+        leg.participant = legs.participant[l];
+        leg.side = legs.side[l];
+    }
+}
+
+void AYS_capi_set_time(AYS_clock &clock, int64_t now){
+    if (now){
+        AYS_clock_set(clock, now);
+    } else {
+        AYS_clock_reset(clock);
+    }
+}
+
+extern "C" {
+
+AYS_API int ays_abi_version(void){
+    return AYS_ABI_VERSION;
+}
+
+AYS_API void ays_options_init(ays_options *options){
+    options->include_live = 0;
+    options->threads = 1;
+    options->min_roi = -std::numeric_limits<float>::infinity();
+    options->now = 0;
+}
+
+AYS_API uint32_t ays_intern_name(const char *name){
+    if (name == NULL){
+        return UINT32_MAX;
+    }
+    return AYS_capi_call("ays_intern_name", (uint32_t)UINT32_MAX, [&]() -> uint32_t {
+        return AYS_intern(AYS_names(), name);
+    });
+}
+
+AYS_API uint32_t ays_intern_currency(const char *currency){
+    if (currency == NULL){
+        return UINT32_MAX;
+    }
+    return AYS_capi_call("ays_intern_currency", (uint32_t)UINT32_MAX, [&]() -> uint32_t {
+        return AYS_intern(AYS_currencies(), currency);
+    });
+}
+
+AYS_API const char *ays_name(uint32_t name){
+    return name < AYS_capi_interned(AYS_names()) ? AYS_name(name).c_str() : NULL;
+}
+
+AYS_API const char *ays_currency(uint32_t currency){
+    return currency < AYS_capi_interned(AYS_currencies()) ? AYS_currency(currency).c_str() : NULL;
+}
+
+AYS_API ays_scanner *ays_scanner_new(const ays_options *options){
+    ays_options defaults;
+    ays_options_init(&defaults);
+    if (options == NULL) options = &defaults;
+    return AYS_capi_call("ays_scanner_new", (ays_scanner *)NULL, [&]() {
+        std::unique_ptr<ays_scanner> scanner(new ays_scanner());
+        scanner->options = AYS_scan_options(options->include_live != 0, NULL, std::max(1, options->threads));
+        scanner->options.min_roi = options->min_roi;
+        scanner->options.arena = &scanner->arena;
+        scanner->options.clock = &scanner->clock;
+        AYS_capi_set_time(scanner->clock, options->now);
+        return scanner.release();
+    });
+}
+
+AYS_API void ays_scanner_free(ays_scanner *scanner){
+    delete scanner;
+}
+
+AYS_API void ays_scanner_set_time(ays_scanner *scanner, int64_t now){
+    AYS_capi_set_time(scanner->clock, now);
+}
+
+AYS_API int64_t ays_scan(ays_scanner *scanner, const ays_fixtures *batch, ays_event *events, uint32_t capacity){
+    if (scanner == NULL || !AYS_capi_check("ays_scan", batch) || (capacity > 0 && events == NULL)){
+        return -1;
+    }
+    if (capacity == 0){
+        return 0;
+    }
+    return AYS_capi_call("ays_scan", [&]() -> int64_t {
+        AYS_store_clear(*scanner->store);
+        AYS_capi_store(*scanner->store, *batch);
+        scanner->options.top_k = capacity;
+        std::vector<AYS_event> result = AYS_store_to_events(scanner->store, scanner->options);
+        uint32_t n = 0;
+        for (auto it = result.rbegin(); it != result.rend(); ++it, n++){ // ascending roi
+            AYS_capi_event(*it, n, scanner->legs, events[n]);
+        }
+        return n;
+    });
+}
+
+AYS_API ays_engine *ays_engine_new(const ays_options *options){
+    ays_options defaults;
+    ays_options_init(&defaults);
+    if (options == NULL) options = &defaults;
+    ays_engine *engine = AYS_capi_call("ays_engine_new", (ays_engine *)NULL, [&]() {
+        return new ays_engine(options->include_live != 0, options->min_roi);
+    });
+    if (engine == NULL) return NULL;
+    engine->engine.clock = &engine->clock;
+    AYS_capi_set_time(engine->clock, options->now);
+    return engine;
+}
+
+AYS_API void ays_engine_free(ays_engine *engine){
+    delete engine;
+}
+
+AYS_API void ays_engine_set_time(ays_engine *engine, int64_t now){
+    AYS_capi_set_time(engine->clock, now);
+}
+
+AYS_API int64_t ays_engine_upsert(ays_engine *engine, const ays_fixtures *batch){
+    if (engine == NULL || !AYS_capi_check("ays_engine_upsert", batch)){
+        return -1;
+    }
+    return AYS_capi_call("ays_engine_upsert", [&]() -> int64_t {
+        int64_t stored = 0;
+        for (uint32_t i = 0; i < batch->count; i++){
+            AYS_capi_fixture(*batch, i, engine->fixture);
+            stored += AYS_engine_upsert(engine->engine, engine->fixture);
+        }
+        return stored;
+    });
+}
+
+AYS_API int ays_engine_remove(ays_engine *engine, uint32_t pid, uint32_t id){
+    if (engine == NULL){
+        return -1;
+    }
+    return AYS_capi_call("ays_engine_remove", [&]() -> int64_t {
+        return AYS_engine_remove(engine->engine, pid, id);
+    });
+}
+
+AYS_API int64_t ays_engine_update(ays_engine *engine, ays_event *crossed, uint32_t capacity){
+    if (engine == NULL || (capacity > 0 && crossed == NULL)){
+        return -1;
+    }
+    return AYS_capi_call("ays_engine_update", [&]() -> int64_t {
+        engine->crossed.clear();
+        AYS_engine_update(engine->engine, engine->crossed);
+        for (uint32_t k = 0; k < capacity && k < engine->crossed.size(); k++){
+            AYS_event_id eid = engine->crossed[k];
+            AYS_capi_event(engine->engine.events[eid], eid, engine->legs, crossed[k]);
+        }
+        return engine->crossed.size();
+    });
+}
+
+AYS_API int64_t ays_engine_events(ays_engine *engine, ays_event *events, uint32_t capacity){
+    if (engine == NULL || (capacity > 0 && events == NULL)){
+        return -1;
+    }
+    return AYS_capi_call("ays_engine_events", [&]() -> int64_t {
+        const AYS_engine &e = engine->engine;
+        std::vector<AYS_event_id> &ranked = engine->ranked;
+        ranked.clear();
+        for (AYS_event_id eid = 0; eid < e.events.size(); eid++){
+            // dirty events wait for the next update
+            if (e.events[eid].fixtures.size() > 0 && !e.dirty[eid] && e.events[eid].roi >= engine->min_roi){
+                ranked.push_back(eid);
+            }
+        }
+        size_t n = std::min<size_t>(capacity, ranked.size());
+        auto better = [&e](AYS_event_id a, AYS_event_id b){ return AYS_roi_compare(e.events[b], e.events[a]); };
+        std::partial_sort(ranked.begin(), ranked.begin() + n, ranked.end(), better);
+        for (size_t k = 0; k < n; k++){
+            AYS_capi_event(e.events[ranked[k]], ranked[k], engine->legs, events[k]);
+        }
+        return n;
+    });
+}
+
+}
@@ -0,0 +1,286 @@
+#include "synthetic_market.cpp"
+#include <chrono>
+#include <cstring>
+
+/*
+ * Staged scan benchmark on the synthetic market.
+ * Every stage of AYS_fixtures_to_events is timed on its own, the best of --repeat runs is kept and one JSON
+ * object per (fixtures, stage) is printed on stdout so runs can be diffed and tracked.
+ * similarity_sort and matching are also timed in isolation on the (anchor, fixture) pairs the clustering
+ * actually compares, the cluster stage includes both.
+ * Usage: bench [--fixtures n]... [--providers n] [--alias-noise p] [--odds-noise w] [--participants min max]
+ *              [--skew s] [--seed n] [--repeat n] [--threads n] [--min-roi r] [--top-k k] [--arena] [--snapshot path]
+ * --min-roi adds the prune stage and --top-k the selection, as in AYS_scan_options. --arena runs the total stage
+ * on one scan arena kept over the repeats and the sizes, like a long running scanner, and adds an "arena" object
+ * with its peak bytes, the allocations of the last scan and the blocks it ever took from the heap.
+ * --snapshot writes the book to path and adds the snapshot_write, snapshot_load and snapshot_total (scan of the
+ * mapped book) stages.
+ * format prints the sure bets with AYS_event_to_string_pretty, jsonl and binary stream them with an
+ * AYS_event_writer to /dev/null.
+ * Without --fixtures it sweeps 10k, 100k and 1M fixtures.
+ */
+typedef std::chrono::steady_clock AYS_bench_clock;
+
+double AYS_elapsed_ns(AYS_bench_clock::time_point start){
+    return std::chrono::duration<double, std::nano>(AYS_bench_clock::now()-start).count();
+}
+
+struct AYS_bench_stage {
+    std::string name;
+    double ns; // best of the repeats
+    uint64_t items;
+    AYS_bench_stage(std::string name, uint64_t items) : name(name), ns(std::numeric_limits<double>::max()), items(items) { }
+};
+
+void AYS_bench_record(std::vector<AYS_bench_stage> &stages, const std::string &name, double ns, uint64_t items){
+    for (auto& stage : stages){
+        if (stage.name == name){
+            stage.ns = std::min(stage.ns, ns);
+            stage.items = items;
+            return;
+        }
+    }
+    stages.emplace_back(name, items);
+    stages.back().ns = ns;
+}
+
+void AYS_bench_run(const AYS_market_params &params, const AYS_scan_options &options, const std::string &snapshot, 
+                   std::vector<AYS_bench_stage> &stages){
+    int threads = options.threads;
+    time_t now = std::time(0);
+    AYS_bench_clock::time_point start = AYS_bench_clock::now();
+    std::vector<AYS_fixture> fs = AYS_synthetic_market(params, now);
+    AYS_bench_record(stages, "generate", AYS_elapsed_ns(start), fs.size());
+    std::vector<std::string> provider_names = AYS_synthetic_provider_names(params);
+
+    start = AYS_bench_clock::now();
+    std::shared_ptr<AYS_fixture_store> store = std::make_shared<AYS_fixture_store>();
+    AYS_store_reserve(*store, fs.size(), fs.size()*params.max_participants);
+    for (auto& fixture : fs){
+        AYS_store_push(*store, fixture);
+    }
+    AYS_bench_record(stages, "store", AYS_elapsed_ns(start), fs.size());
+    const AYS_fixture_store &s = *store;
+
+    start = AYS_bench_clock::now();
+    AYS_arena_vector<uint32_t> filtered_idx;
+    filtered_idx.reserve(AYS_store_size(s));
+    for (uint32_t row = 0; row < AYS_store_size(s); row++){
+        if (AYS_store_filter(s, row, now, false)){
+            filtered_idx.push_back(row);
+        }
+    }
+    AYS_bench_record(stages, "filter", AYS_elapsed_ns(start), AYS_store_size(s));
+
+    start = AYS_bench_clock::now();
+    AYS_arena_vector<uint32_t> order;
+    AYS_arena_vector<AYS_bucket> buckets;
+    AYS_bucket_fixtures(s, filtered_idx, order, buckets);
+    AYS_bench_record(stages, "bucket", AYS_elapsed_ns(start), filtered_idx.size());
+
+    if (options.min_roi > -std::numeric_limits<float>::infinity()){
+        start = AYS_bench_clock::now();
+        size_t n = buckets.size();
+        AYS_prune_buckets(s, order, buckets, options.min_roi, threads);
+        AYS_bench_record(stages, "prune", AYS_elapsed_ns(start), n);
+    }
+
+    start = AYS_bench_clock::now();
+    std::vector<AYS_event> events;
+    if (threads <= 1){
+        AYS_cluster_scratch scratch;
+        for (const AYS_bucket &bucket : buckets){
+            AYS_cluster_bucket(store, order, bucket, NULL, scratch, events);
+        }
+    } else {
+        std::vector<AYS_cluster_scratch> scratch(threads);
+        std::vector<std::vector<AYS_event>> bucket_events(buckets.size());
+        AYS_parallel_for(threads, buckets.size(), [&](int worker, uint32_t b){
+            AYS_cluster_bucket(store, order, buckets[b], NULL, scratch[worker], bucket_events[b]);
+        });
+        for (auto& be : bucket_events){
+            std::move(be.begin(), be.end(), std::back_inserter(events));
+        }
+    }
+    AYS_bench_record(stages, "cluster", AYS_elapsed_ns(start), filtered_idx.size());
+
+    // the pairs the clustering compares: every later fixture of an event against its anchor
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    for (auto& event : events){
+        for (int i = 1; i < (int)event.fixtures.size(); i++){
+            pairs.push_back(std::make_pair(event.fixtures[0], event.fixtures[i]));
+        }
+    }
+    std::vector<int> sol;
+    std::vector<int> matrices;
+    std::vector<int> sizes;
+    start = AYS_bench_clock::now();
+    float sink = 0;
+    for (auto& p : pairs){
+        int n = AYS_store_participants(s, p.first);
+        sink += similarity_sort(&s.participant_ids[s.offset[p.first]], &s.participant_ids[s.offset[p.second]], n, &sol);
+    }
+    AYS_bench_record(stages, "similarity_sort", AYS_elapsed_ns(start), pairs.size());
+    for (auto& p : pairs){
+        int n = AYS_store_participants(s, p.first);
+        sizes.push_back(n);
+        matrices.resize(matrices.size() + n*n);
+        AYS_name_distances(&s.participant_ids[s.offset[p.first]], &s.participant_ids[s.offset[p.second]], n, &matrices[matrices.size() - n*n]);
+    }
+    int solution[16];
+    start = AYS_bench_clock::now();
+    size_t offset = 0;
+    for (int n : sizes){
+        sink += AYS_assign(n, &matrices[offset], solution);
+        offset += n*n;
+    }
+    AYS_bench_record(stages, "matching", AYS_elapsed_ns(start), sizes.size());
+
+    start = AYS_bench_clock::now();
+    if (threads <= 1){
+        AYS_arb_batch batch;
+        AYS_events_arb(events, batch);
+    } else {
+        const uint32_t chunk = 4096;
+        std::vector<AYS_arb_batch> batches(threads);
+        AYS_parallel_for(threads, (events.size()+chunk-1)/chunk, [&](int worker, uint32_t c){
+            AYS_arena_vector<uint32_t> subset;
+            for (uint32_t e = c*chunk; e < std::min<size_t>(events.size(), (c+1)*chunk); e++){
+                subset.push_back(e);
+            }
+            AYS_events_arb(events, batches[worker], &subset);
+        });
+    }
+    AYS_bench_record(stages, "arb", AYS_elapsed_ns(start), events.size());
+
+    start = AYS_bench_clock::now();
+    size_t unsorted = events.size();
+    if (options.min_roi > -std::numeric_limits<float>::infinity()){
+        float min_roi = options.min_roi;
+        events.erase(std::remove_if(events.begin(), events.end(), [min_roi](const AYS_event &e){ return !(e.roi >= min_roi); }), 
+                     events.end());
+    }
+    if (options.top_k > 0 && options.top_k < events.size()){
+        std::nth_element(events.begin(), events.end()-options.top_k, events.end(), AYS_roi_compare);
+        events.erase(events.begin(), events.end()-options.top_k);
+    }
+    std::sort(events.begin(), events.end(), AYS_roi_compare);
+    AYS_bench_record(stages, "sort", AYS_elapsed_ns(start), unsorted);
+
+    start = AYS_bench_clock::now();
+    size_t bytes = 0;
+    uint64_t arbs = 0;
+    for (auto& event : events){
+        if (event.roi > 0){
+            bytes += AYS_event_to_string_pretty(event, provider_names).size();
+            arbs++;
+        }
+    }
+    AYS_bench_record(stages, "format", AYS_elapsed_ns(start), arbs);
+
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0){
+        AYS_event_writer jsonl(null_fd, AYS_OUTPUT_JSONL);
+        jsonl.provider_names = &provider_names;
+        start = AYS_bench_clock::now();
+        AYS_writer_write(jsonl, events, std::numeric_limits<float>::min());
+        AYS_bench_record(stages, "jsonl", AYS_elapsed_ns(start), jsonl.events);
+        AYS_event_writer binary(null_fd, AYS_OUTPUT_BINARY);
+        start = AYS_bench_clock::now();
+        AYS_writer_write(binary, events, std::numeric_limits<float>::min());
+        AYS_bench_record(stages, "binary", AYS_elapsed_ns(start), binary.events);
+        close(null_fd);
+    }
+
+    start = AYS_bench_clock::now();
+    std::vector<AYS_event> res = AYS_store_to_events(store, options);
+    AYS_bench_record(stages, "total", AYS_elapsed_ns(start), AYS_store_size(s));
+    if (res.size() != events.size() || sink < 0){
+        std::cerr << "bench: staged scan and AYS_store_to_events disagree (" << events.size() << " vs " << res.size() << " events)" << std::endl;
+    }
+    res.clear();
+
+    if (snapshot.empty()) return;
+    start = AYS_bench_clock::now();
+    if (!AYS_snapshot_write(s, snapshot)) return;
+    AYS_bench_record(stages, "snapshot_write", AYS_elapsed_ns(start), AYS_store_size(s));
+    start = AYS_bench_clock::now();
+    std::shared_ptr<const AYS_fixture_store> mapped = AYS_snapshot_load(snapshot);
+    if (!mapped) return;
+    AYS_bench_record(stages, "snapshot_load", AYS_elapsed_ns(start), AYS_store_size(*mapped));
+    start = AYS_bench_clock::now();
+    res = AYS_store_to_events(mapped, options);
+    AYS_bench_record(stages, "snapshot_total", AYS_elapsed_ns(start), AYS_store_size(*mapped));
+    if (res.size() != events.size()){
+        std::cerr << "bench: scan of the snapshot disagrees (" << events.size() << " vs " << res.size() << " events)" << std::endl;
+    }
+}
+
+int main (int argc, char *argv[]) {
+    AYS_market_params params;
+    AYS_scan_options options;
+    AYS_scan_arena arena;
+    std::string snapshot;
+    std::vector<uint32_t> sweep;
+    int repeat = 3;
+    for (int i = 1; i < argc; i++){
+        bool has_value = i+1 < argc;
+        if (!strcmp(argv[i], "--fixtures") && has_value) sweep.push_back(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--providers") && has_value) params.providers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--alias-noise") && has_value) params.alias_noise = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--odds-noise") && has_value) params.odds_noise = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--participants") && i+2 < argc){
+            params.min_participants = atoi(argv[++i]);
+            params.max_participants = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--skew") && has_value) params.bucket_skew = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && has_value) params.seed = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--repeat") && has_value) repeat = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--threads") && has_value) options.threads = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--min-roi") && has_value) options.min_roi = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--top-k") && has_value) options.top_k = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--arena")) options.arena = &arena;
+        else if (!strcmp(argv[i], "--snapshot") && has_value) snapshot = argv[++i];
+        else {
+            std::cerr << "unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (params.min_participants < 1 || params.min_participants > params.max_participants || params.max_participants > 3){
+        std::cerr << "participants must satisfy 1 <= min <= max <= 3" << std::endl;
+        return 1;
+    }
+    if (sweep.empty()){
+        sweep = {10000, 100000, 1000000};
+    }
+    for (uint32_t fixtures : sweep){
+        params.fixtures = fixtures;
+        // keep the quotes per team and the fixtures per kickoff roughly constant so the sizes compare
+        params.teams = std::max<uint32_t>(200, fixtures/20);
+        params.kickoff_slots = std::max<uint32_t>(96, fixtures/100);
+        std::vector<AYS_bench_stage> stages;
+        for (int r = 0; r < repeat; r++){
+            AYS_bench_run(params, options, snapshot, stages);
+        }
+        for (auto& stage : stages){
+            std::cout << fmt::format("{{\"fixtures\":{},\"providers\":{},\"alias_noise\":{},\"odds_noise\":{},\"participants\":[{},{}],"
+                                     "\"skew\":{},\"seed\":{},\"threads\":{},\"min_roi\":{},\"top_k\":{},\"repeat\":{},"
+                                     "\"stage\":\"{}\",\"ns\":{:.0f},\"items\":{},\"ns_per_item\":{:.2f}}}\n",
+                                     fixtures, params.providers, params.alias_noise, params.odds_noise, params.min_participants, 
+                                     params.max_participants, params.bucket_skew, params.seed, options.threads, 
+                                     options.min_roi > -std::numeric_limits<float>::infinity() ? fmt::format("{}", options.min_roi) : "null", 
+                                     options.top_k, repeat, stage.name, stage.ns, stage.items, stage.items ? stage.ns/stage.items : 0.);
+        }
+        if (options.arena){
+            uint64_t allocations = 0, heap_blocks = 0;
+            for (auto& a : arena.arenas){
+                allocations += a.allocations;
+                heap_blocks += a.heap_blocks;
+            }
+            std::cout << fmt::format("{{\"fixtures\":{},\"threads\":{},\"stage\":\"arena\",\"peak_bytes\":{},\"allocations\":{},\"heap_blocks\":{}}}\n", 
+                                     fixtures, options.threads, AYS_scan_arena_peak(arena), allocations, heap_blocks);
+        }
+        std::cout.flush();
+    }
+    return 0;
+}
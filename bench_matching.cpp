@@ -0,0 +1,50 @@
+#define AYS_LEMON
+#include "are_you_sure.cpp"
+#include <chrono>
+#include <random>
+
+// compares the assignment solvers in min_weight_matching against the LEMON min-cost-flow
+// on random Levenshtein-sized cost matrices. Cost mismatches are wrong answers, permutation mismatches are ties
+// resolved differently than LEMON. Usage: bench_matching [iterations]
+int main (int argc, char *argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+    std::mt19937 g(42);
+    for (int pairs = 2; pairs <= 8; pairs++){
+        std::vector<std::vector<std::vector<int>>> matrices(1024, std::vector<std::vector<int>>(pairs, std::vector<int>(pairs)));
+        for (auto& m : matrices){
+            for (auto& row : m){
+                for (auto& x : row){
+                    x = g()%30;
+                }
+            }
+        }
+        std::vector<int> sol(pairs);
+        std::vector<int> ref(pairs);
+        int mismatches = 0, permutation_mismatches = 0;
+        for (auto& m : matrices){
+            min_weight_matching(pairs, m, sol);
+            min_weight_matching_lemon(pairs, m, ref);
+            int cost = 0, ref_cost = 0;
+            for (int i = 0; i < pairs; i++){
+                cost += m[i][sol[i]];
+                ref_cost += m[i][ref[i]];
+            }
+            mismatches += cost != ref_cost;
+            permutation_mismatches += sol != ref;
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int it = 0; it < iterations; it++){
+            min_weight_matching(pairs, matrices[it&1023], sol);
+        }
+        auto mid = std::chrono::steady_clock::now();
+        for (int it = 0; it < iterations; it++){
+            min_weight_matching_lemon(pairs, matrices[it&1023], ref);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(mid-start).count()/iterations;
+        double lemon_ns = std::chrono::duration<double, std::nano>(end-mid).count()/iterations;
+        std::cout << fmt::format("pairs: {} assign: {:.1f} ns lemon: {:.1f} ns speedup: {:.1f}x cost mismatches: {} permutation mismatches: {}\n", 
+                                 pairs, ns, lemon_ns, lemon_ns/ns, mismatches, permutation_mismatches);
+    }
+    return 0;
+}
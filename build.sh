@@ -1,2 +1,10 @@
 set -ex
-g++ -I ~/lemon/include -std=c++20 example.cpp -g -DNDEBUG -march=native -std=c++11 -Wall -Wno-maybe-uninitialized -L ~/lemon/lib -lemon -o example
+g++ -std=c++20 example.cpp -g -DNDEBUG -march=native -std=c++11 -Wall -Wno-maybe-uninitialized -pthread -o example
+if [ -d ~/lemon ]; then # the LEMON reference solver is optional
+    g++ -I ~/lemon/include -std=c++20 bench_matching.cpp -O2 -DNDEBUG -march=native -std=c++11 -Wall -Wno-maybe-uninitialized -L ~/lemon/lib -lemon -pthread -o bench_matching
+fi
+g++ -std=c++20 bench.cpp -O2 -DNDEBUG -march=native -std=c++11 -Wall -Wno-maybe-uninitialized -pthread -o bench
+g++ -std=c++20 replay.cpp -O2 -DNDEBUG -march=native -std=c++11 -Wall -Wno-maybe-uninitialized -pthread -o replay
+g++ -std=c++20 shard.cpp -O2 -DNDEBUG -march=native -std=c++11 -Wall -Wno-maybe-uninitialized -pthread -o shard
+g++ -std=c++20 are_you_sure_c.cpp -O2 -DNDEBUG -march=native -std=c++11 -Wall -Wno-maybe-uninitialized -fPIC -shared -fvisibility=hidden -Wl,--version-script=are_you_sure.map -pthread -o libare_you_sure.so
+g++ -std=c++20 engine_check.cpp -O2 -DNDEBUG -D_GLIBCXX_ASSERTIONS -march=native -std=c++11 -Wall -Wno-maybe-uninitialized -pthread -o engine_check
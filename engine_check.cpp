@@ -0,0 +1,154 @@
+#include "synthetic_market.cpp"
+#include <cstring>
+
+/*
+ * Consistency check of AYS_engine, built with -D_GLIBCXX_ASSERTIONS so an out of bounds read aborts.
+ * Runs the sequences that reuse an event after fixtures left it (a renamed fixture, a remove followed by an upsert
+ * into the same bucket, the anchor of an event leaving it), then --rounds rounds of random quotes, renames and
+ * removals on a synthetic book, checking after every update that each fixture of the book is found where its entry
+ * points and that the events are evaluated like a scan would evaluate them.
+ * Prints the failed checks and exits with 1 if there are any.
+ * Usage: engine_check [--fixtures n] [--rounds n] [--seed n]
+ */
+static int AYS_check_failures = 0;
+
+void AYS_check(bool ok, const std::string &what){
+    if (!ok){
+        std::cout << "failed: " << what << '\n';
+        AYS_check_failures++;
+    }
+}
+
+AYS_fixture AYS_check_fixture(AYS_provider_id pid, AYS_fixture_id id, time_t now, const char *home, const char *away, float odds = 0.5){
+    std::vector<AYS_participant> names = {home, away};
+    std::vector<AYS_odd> not_odds = {1, 1};
+    std::vector<AYS_odd> participant_odds = {odds, 1-odds};
+    return AYS_fixture(now+3600, now+600, pid, id, 0, 0, 0, "DKK", 100, names, not_odds, participant_odds);
+}
+
+// the number of events holding fixtures
+size_t AYS_check_events(const AYS_engine &engine){
+    size_t events = 0;
+    for (auto& event : engine.events){
+        events += event.fixtures.size() > 0;
+    }
+    return events;
+}
+
+void AYS_check_book(const AYS_engine &engine, const std::string &when){
+    const AYS_fixture_store &s = *engine.store;
+    size_t fixtures = 0;
+    for (AYS_event_id eid = 0; eid < engine.events.size(); eid++){
+        const AYS_event &event = engine.events[eid];
+        fixtures += event.fixtures.size();
+        AYS_check(event.slots.size() == event.fixtures.size()*event.participants, when + ": slots of an event");
+        for (uint32_t pos = 0; pos < event.fixtures.size(); pos++){
+            uint32_t row = event.fixtures[pos];
+            auto it = engine.entries.find(AYS_fixture_key(s.pid[row], s.id[row]));
+            AYS_check(it != engine.entries.end() && it->second.event == eid && it->second.pos == pos, when + ": entry of a fixture");
+        }
+        if (event.fixtures.empty()) continue;
+        AYS_arena_vector<uint32_t> rows(event.fixtures);
+        AYS_arena_vector<uint8_t> slots(event.slots);
+        std::vector<AYS_event> fresh;
+        fresh.emplace_back(event.store, rows, slots);
+        AYS_arb_batch batch;
+        AYS_events_arb(fresh, batch);
+        AYS_check(fresh[0].roi == event.roi, when + ": roi of an event");
+    }
+    AYS_check(fixtures == engine.entries.size(), when + ": fixtures of the book");
+}
+
+int main (int argc, char *argv[]) {
+    AYS_market_params params(2000);
+    int rounds = 20;
+    for (int i = 1; i < argc; i++){
+        bool has_value = i+1 < argc;
+        if (!strcmp(argv[i], "--fixtures") && has_value) params.fixtures = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--rounds") && has_value) rounds = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--seed") && has_value) params.seed = strtoull(argv[++i], NULL, 10);
+        else {
+            std::cerr << "unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    time_t now = 1800000000;
+    AYS_clock clock;
+    AYS_clock_set(clock, now);
+    std::vector<AYS_event_id> crossed;
+    {
+        // a rename leaves the event empty until the update, the new name is matched against it
+        AYS_engine engine;
+        engine.clock = &clock;
+        AYS_engine_upsert(engine, AYS_check_fixture(0, 1, now, "Arsenal", "Chelsea"));
+        AYS_engine_update(engine, crossed);
+        AYS_engine_upsert(engine, AYS_check_fixture(0, 1, now, "Arsenal FC", "Chelsea"));
+        AYS_engine_update(engine, crossed);
+        AYS_check(engine.entries.size() == 1 && AYS_check_events(engine) == 1, "rename");
+        AYS_check_book(engine, "rename");
+    }
+    {
+        // remove, then upsert into the same bucket before the update, the event keeps its participant order
+        AYS_engine engine;
+        engine.clock = &clock;
+        AYS_engine_upsert(engine, AYS_check_fixture(0, 1, now, "Arsenal", "Chelsea"));
+        AYS_engine_update(engine, crossed);
+        AYS_engine_remove(engine, 0, 1);
+        AYS_engine_upsert(engine, AYS_check_fixture(1, 1, now, "Chelsea", "Arsenal"));
+        AYS_engine_update(engine, crossed);
+        AYS_check(engine.entries.size() == 1 && AYS_check_events(engine) == 1, "remove then upsert");
+        AYS_check_book(engine, "remove then upsert");
+        AYS_check(engine.events[engine.entries.begin()->second.event].participant_name(0) == "Arsenal", "remove then upsert: order");
+    }
+    {
+        // the anchor leaves, new fixtures are still matched against its names in the event's order
+        AYS_engine engine;
+        engine.clock = &clock;
+        AYS_engine_upsert(engine, AYS_check_fixture(0, 1, now, "Arsenal", "Chelsea", 0.4));
+        AYS_engine_upsert(engine, AYS_check_fixture(1, 1, now, "Chelsea", "Arsenal", 0.6));
+        AYS_engine_upsert(engine, AYS_check_fixture(2, 1, now, "Arsenal", "Chelsea", 0.4));
+        AYS_engine_update(engine, crossed);
+        AYS_engine_remove(engine, 0, 1);
+        AYS_engine_upsert(engine, AYS_check_fixture(3, 1, now, "Chelsea", "Arsenal", 0.4));
+        AYS_engine_update(engine, crossed);
+        AYS_check(engine.entries.size() == 3 && AYS_check_events(engine) == 1, "anchor removed");
+        AYS_check_book(engine, "anchor removed");
+        const AYS_event &event = engine.events[engine.entries.begin()->second.event];
+        const AYS_fixture_store &s = *engine.store;
+        AYS_check(s.pid[event.fixtures[0]] == 1, "anchor removed: oldest fixture leads");
+        for (uint32_t i = 0; i < event.fixtures.size(); i++){
+            AYS_check(event.name(i, 0).find("Arsenal") == 0, "anchor removed: slots");
+        }
+    }
+    {
+        // random churn on a synthetic book
+        AYS_engine engine;
+        engine.clock = &clock;
+        std::vector<AYS_fixture> book = AYS_synthetic_market(params, now);
+        AYS_rng rng(params.seed);
+        for (int r = 0; r < rounds; r++){
+            for (auto& fixture : book){
+                float u = rng.uniform();
+                if (u < 0.1){
+                    AYS_engine_remove(engine, fixture.pid, fixture.id);
+                    continue;
+                }
+                if (u < 0.15 && fixture.participant_names.size() > 1){
+                    std::swap(fixture.participant_names[0], fixture.participant_names[1]);
+                } else if (u < 0.2){
+                    fixture.participant_names[0] += " FC";
+                } else if (u < 0.6){
+                    for (auto& odd : fixture.participant_odds){
+                        if (odd < 1) odd = std::min(0.99f, odd*(0.9f+0.2f*rng.uniform()));
+                    }
+                }
+                AYS_engine_upsert(engine, fixture);
+            }
+            crossed.clear();
+            AYS_engine_update(engine, crossed);
+            AYS_check_book(engine, fmt::format("round {}", r));
+        }
+    }
+    std::cout << (AYS_check_failures ? "failed" : "ok") << '\n';
+    return AYS_check_failures ? 1 : 0;
+}
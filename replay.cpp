@@ -0,0 +1,268 @@
+#include "synthetic_market.cpp"
+#include <chrono>
+#include <cstring>
+
+/*
+ * Deterministic replay of a feed log recorded with AYS_scan_options::recorder.
+ * Every batch is scanned on a manual AYS_clock set to the time it was recorded at, so the expiry and live filters
+ * decide exactly as they did live and a replay reproduces the recorded scans bit for bit at any speed. Batches are
+ * paced by their recorded wall times divided by --speed, 0 replays as fast as possible. --engine feeds the batches
+ * to an AYS_engine (upsert every fixture, then update) instead of a full scan per batch. --dedup scans through an
+ * AYS_dedup, which reuses the clustering of the buckets whose names did not change, and prints its counters.
+ * One JSON object per batch is printed on stdout with the scan latency, how late the batch started against its
+ * schedule and a digest of the sure bets found, then a summary object. Equal digests mean equal results.
+ * --record writes a synthetic log instead: --batches books of --fixtures fixtures, --interval-ms apart, where
+ * --churn of the quotes move between two batches.
+ * --ingest runs the log through an AYS_ingest pipeline instead, one feed and producer thread per provider pushing
+ * as fast as it can, polled every --cadence-ms into an engine. --noisy pid makes that provider send every batch
+ * --burst times, --queue sizes the feed rings and --block waits for room instead of dropping. The pipeline
+ * counters are printed at the end, the latency of the polls shows how much the noisy feed slows down the others.
+ * Usage: replay log [--speed s] [--engine] [--dedup] [--threads n] [--min-roi r] [--include-live]
+ *        replay log --ingest [--cadence-ms ms] [--budget n] [--queue n] [--block] [--noisy pid] [--burst n]
+ *        replay --record log [--fixtures n] [--batches n] [--interval-ms ms] [--churn p] [--seed n]
+ */
+typedef std::chrono::steady_clock AYS_replay_clock;
+
+uint64_t AYS_digest_mix(uint64_t h, uint64_t v){
+    h ^= v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    return h;
+}
+
+// order independent digest of the events with a positive roi: their fixtures and their rounded roi
+uint64_t AYS_replay_event_digest(const AYS_event &event){
+    std::vector<uint64_t> keys;
+    const AYS_fixture_store &s = *event.store;
+    for (uint32_t row : event.fixtures){
+        keys.push_back(((uint64_t)s.pid[row] << 32) | s.id[row]);
+    }
+    std::sort(keys.begin(), keys.end());
+    uint64_t h = std::llround(event.roi*1e4);
+    for (uint64_t key : keys){
+        h = AYS_digest_mix(h, key);
+    }
+    return h;
+}
+
+struct AYS_replay_result {
+    size_t events;
+    size_t sure_bets;
+    uint64_t digest;
+    AYS_replay_result() : events(0), sure_bets(0), digest(0) { }
+};
+
+void AYS_replay_add(AYS_replay_result &result, const AYS_event &event){
+    result.events++;
+    if (event.roi > 0){
+        result.sure_bets++;
+        result.digest += AYS_replay_event_digest(event);
+    }
+}
+
+int AYS_replay_record(const std::string &path, AYS_market_params params, int batches, int interval_ms, float churn){
+    AYS_feed_recorder recorder;
+    if (!AYS_recorder_open(recorder, path)) return 1;
+    AYS_clock clock;
+    time_t now = std::time(0);
+    AYS_clock_set(clock, now);
+    std::vector<AYS_fixture> book = AYS_synthetic_market(params, now);
+    AYS_rng rng(params.seed ^ 0x5EED);
+    AYS_scan_options options;
+    options.clock = &clock;
+    options.recorder = &recorder;
+    for (int b = 0; b < batches; b++){
+        if (b > 0){
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+            now += std::max(1, interval_ms/1000);
+            AYS_clock_set(clock, now);
+            for (auto& f : book){
+                if (rng.uniform() >= churn) continue;
+                for (size_t j = 0; j < f.participant_odds.size(); j++){
+                    float move = 1 + 0.04f*(rng.uniform()-0.5f);
+                    f.participant_odds[j] *= move;
+                    f.participant_not_odds[j] /= move;
+                }
+            }
+        }
+        std::vector<AYS_event> events = AYS_fixtures_to_events(book, options);
+        AYS_replay_result result;
+        for (auto& event : events){
+            AYS_replay_add(result, event);
+        }
+        std::cout << fmt::format("{{\"batch\":{},\"clock\":{},\"fixtures\":{},\"events\":{},\"sure_bets\":{},\"digest\":\"{:016x}\"}}\n",
+                                 b, (int64_t)now, book.size(), result.events, result.sure_bets, result.digest);
+    }
+    AYS_recorder_close(recorder);
+    return recorder.batches == (uint64_t)batches ? 0 : 1;
+}
+
+struct AYS_replay_ingest_params {
+    int cadence_ms;
+    uint32_t budget;
+    uint32_t queue;
+    AYS_backpressure backpressure;
+    int64_t noisy;
+    int burst;
+    AYS_replay_ingest_params() : cadence_ms(10), budget(4096), queue(1 << 14), backpressure(AYS_FEED_DROP), noisy(-1), burst(10) { }
+};
+
+int AYS_replay_ingest(const std::string &log, bool include_live, const AYS_replay_ingest_params &params){
+    AYS_feed_reader reader;
+    AYS_feed_batch batch;
+    if (!AYS_reader_open(reader, log) || !AYS_feed_next(reader, batch)) return 1;
+    std::vector<AYS_provider_id> providers;
+    for (auto& f : batch.fixtures){
+        if (std::find(providers.begin(), providers.end(), f.pid) == providers.end()) providers.push_back(f.pid);
+    }
+    std::sort(providers.begin(), providers.end());
+    AYS_clock clock;
+    AYS_clock_set(clock, batch.clock); // the whole log is ingested as of its first batch
+    AYS_engine engine(include_live);
+    engine.clock = &clock;
+    AYS_ingest ingest(engine, params.budget, std::chrono::milliseconds(params.cadence_ms));
+    for (AYS_provider_id pid : providers){
+        AYS_feed &feed = AYS_ingest_add_feed(ingest, fmt::format("prov{}", pid), params.queue, params.backpressure);
+        feed.source = std::thread([&feed, &log, &params, pid](){
+            AYS_feed_reader reader;
+            AYS_feed_batch batch;
+            if (!AYS_reader_open(reader, log)) return;
+            int repeat = (int64_t)pid == params.noisy ? params.burst : 1;
+            while (!feed.closed.load() && AYS_feed_next(reader, batch)){
+                for (int r = 0; r < repeat; r++){
+                    for (auto& f : batch.fixtures){
+                        if (f.pid != pid) continue;
+                        AYS_fixture copy = f;
+                        AYS_feed_push(feed, copy);
+                    }
+                }
+            }
+            feed.closed = true;
+        });
+    }
+    uint64_t crossed = 0;
+    ingest.on_update = [&crossed](AYS_engine &engine, const std::vector<AYS_event_id> &events){ crossed += events.size(); };
+    AYS_replay_clock::time_point start = AYS_replay_clock::now();
+    AYS_ingest_start(ingest);
+    AYS_ingest_stop(ingest, true);
+    double ns = std::chrono::duration<double, std::nano>(AYS_replay_clock::now()-start).count();
+    AYS_replay_result result;
+    for (auto& event : engine.events){
+        if (event.fixtures.size() > 0) AYS_replay_add(result, event);
+    }
+    std::cout << AYS_ingest_stats(ingest) << '\n';
+    std::cout << fmt::format("{{\"mode\":\"ingest\",\"events\":{},\"sure_bets\":{},\"crossed\":{},\"ns\":{:.0f}}}\n", 
+                             result.events, result.sure_bets, crossed, ns);
+    return 0;
+}
+
+int main (int argc, char *argv[]) {
+    AYS_market_params params(10000);
+    AYS_scan_options options;
+    std::string log, record;
+    double speed = 1;
+    bool engine_mode = false;
+    bool ingest_mode = false;
+    bool dedup_mode = false;
+    AYS_replay_ingest_params ingest_params;
+    int batches = 10, interval_ms = 100;
+    float churn = 0.05;
+    for (int i = 1; i < argc; i++){
+        bool has_value = i+1 < argc;
+        if (!strcmp(argv[i], "--speed") && has_value) speed = std::max(0., atof(argv[++i]));
+        else if (!strcmp(argv[i], "--engine")) engine_mode = true;
+        else if (!strcmp(argv[i], "--ingest")) ingest_mode = true;
+        else if (!strcmp(argv[i], "--dedup")) dedup_mode = true;
+        else if (!strcmp(argv[i], "--cadence-ms") && has_value) ingest_params.cadence_ms = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--budget") && has_value) ingest_params.budget = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--queue") && has_value) ingest_params.queue = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--block")) ingest_params.backpressure = AYS_FEED_BLOCK;
+        else if (!strcmp(argv[i], "--noisy") && has_value) ingest_params.noisy = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--burst") && has_value) ingest_params.burst = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--threads") && has_value) options.threads = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--min-roi") && has_value) options.min_roi = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--include-live")) options.include_live = true;
+        else if (!strcmp(argv[i], "--record") && has_value) record = argv[++i];
+        else if (!strcmp(argv[i], "--fixtures") && has_value) params.fixtures = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--batches") && has_value) batches = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--interval-ms") && has_value) interval_ms = std::max(0, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--churn") && has_value) churn = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && has_value) params.seed = strtoull(argv[++i], NULL, 10);
+        else if (argv[i][0] != '-' && log.empty()) log = argv[i];
+        else {
+            std::cerr << "unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (!record.empty()){
+        params.teams = std::max<uint32_t>(200, params.fixtures/20);
+        params.kickoff_slots = std::max<uint32_t>(96, params.fixtures/100);
+        return AYS_replay_record(record, params, batches, interval_ms, churn);
+    }
+    if (log.empty()){
+        std::cerr << "usage: replay log [--speed s] [--engine] | replay log --ingest | replay --record log" << std::endl;
+        return 1;
+    }
+    if (ingest_mode){
+        return AYS_replay_ingest(log, options.include_live, ingest_params);
+    }
+
+    AYS_feed_reader reader;
+    if (!AYS_reader_open(reader, log)) return 1;
+    AYS_clock clock;
+    options.clock = &clock;
+    AYS_dedup dedup;
+    if (dedup_mode) options.dedup = &dedup;
+    AYS_engine engine(options.include_live);
+    engine.clock = &clock;
+    std::vector<AYS_event_id> crossed;
+    AYS_feed_batch batch;
+    AYS_replay_result total;
+    uint64_t digest = 0;
+    int64_t first_wall_ns = 0;
+    int n = 0;
+    AYS_replay_clock::time_point start = AYS_replay_clock::now();
+    while (AYS_feed_next(reader, batch)){
+        if (n == 0) first_wall_ns = batch.wall_ns;
+        AYS_replay_clock::time_point due = start;
+        if (speed > 0){
+            due += std::chrono::nanoseconds((int64_t)((batch.wall_ns-first_wall_ns)/speed));
+            std::this_thread::sleep_until(due);
+        }
+        AYS_replay_clock::time_point begin = AYS_replay_clock::now();
+        double lag_ns = speed > 0 ? std::chrono::duration<double, std::nano>(begin-due).count() : 0;
+        AYS_clock_set(clock, batch.clock);
+        size_t fixtures = batch.fixtures.size();
+        AYS_replay_result result;
+        if (engine_mode){
+            for (auto& f : batch.fixtures){
+                AYS_engine_upsert(engine, f);
+            }
+            crossed.clear();
+            AYS_engine_update(engine, crossed);
+            for (auto& event : engine.events){
+                if (event.fixtures.size() > 0) AYS_replay_add(result, event);
+            }
+        } else {
+            std::vector<AYS_event> events = AYS_fixtures_to_events(std::move(batch.fixtures), options);
+            for (auto& event : events){
+                AYS_replay_add(result, event);
+            }
+        }
+        double ns = std::chrono::duration<double, std::nano>(AYS_replay_clock::now()-begin).count();
+        std::cout << fmt::format("{{\"batch\":{},\"clock\":{},\"fixtures\":{},\"events\":{},\"sure_bets\":{},\"digest\":\"{:016x}\","
+                                 "\"ns\":{:.0f},\"lag_ns\":{:.0f}}}\n",
+                                 n, (int64_t)batch.clock, fixtures, result.events, result.sure_bets, result.digest, ns, lag_ns);
+        total.events += result.events;
+        total.sure_bets += result.sure_bets;
+        digest = AYS_digest_mix(digest, result.digest);
+        n++;
+    }
+    double ns = std::chrono::duration<double, std::nano>(AYS_replay_clock::now()-start).count();
+    std::cout << fmt::format("{{\"batches\":{},\"mode\":\"{}\",\"speed\":{},\"events\":{},\"sure_bets\":{},\"digest\":\"{:016x}\",\"ns\":{:.0f}}}\n",
+                             n, engine_mode ? "engine" : "scan", speed, total.events, total.sure_bets, digest, ns);
+    if (dedup_mode && !engine_mode){
+        std::cout << fmt::format("{{\"quotes\":{},\"duplicates\":{},\"superseded\":{},\"unchanged\":{},\"clusterings\":{},\"events_reused\":{}}}\n", 
+                                 dedup.quotes, dedup.duplicates, dedup.superseded, dedup.unchanged_quotes, dedup.clusters.size(), 
+                                 dedup.events_reused);
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "synthetic_market.cpp"
+#include <chrono>
+#include <cstring>
+#include <csignal>
+#include <sys/wait.h>
+
+/*
+ * Sharded scans on one machine.
+ * Forks --shards worker processes (AYS_shard_serve), each listening on its own unix socket, and scans --books
+ * synthetic books (a new seed per book) through an AYS_shard_coordinator connected to them, and in this process
+ * for reference. --skew makes the early kickoff windows hot, --window and --slack set the cells and the imbalance
+ * rebalancing allows, --no-rebalance keeps the hashed placement.
+ * One JSON object per book is printed with both latencies, the fixtures per shard, the cells moved and whether the
+ * merged events are the events of the single process scan (same binary records in the same roi order).
+ * Usage: shard [--shards n] [--fixtures n] [--books n] [--window s] [--slack x] [--skew s] [--no-rebalance]
+ *              [--threads n] [--min-roi r] [--seed n]
+ */
+typedef std::chrono::steady_clock AYS_shard_clock;
+
+// the records of a buffer in AYS_OUTPUT_BINARY format
+std::vector<std::string> AYS_shard_records(const fmt::memory_buffer &buffer){
+    std::vector<std::string> records;
+    for (size_t pos = 0; pos + sizeof(uint16_t) <= buffer.size();){
+        uint16_t size = AYS_binary_load<uint16_t>(buffer.data() + pos);
+        records.emplace_back(buffer.data() + pos, std::min<size_t>(size, buffer.size() - pos));
+        pos += std::max<uint16_t>(size, 1);
+    }
+    return records;
+}
+
+float AYS_shard_record_roi(const std::string &record){
+    return AYS_binary_load<float>(record.data() + AYS_BINARY_ROI_OFFSET);
+}
+
+// same records, and the same roi at every rank (events of equal roi may come in any order)
+bool AYS_shard_same(std::vector<std::string> a, std::vector<std::string> b){
+    if (a.size() != b.size()) return false;
+    for (size_t k = 0; k < a.size(); k++){
+        if (AYS_shard_record_roi(a[k]) != AYS_shard_record_roi(b[k])) return false;
+    }
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    return a == b;
+}
+
+int main (int argc, char *argv[]) {
+    AYS_market_params params(100000);
+    AYS_scan_options options;
+    uint32_t shards = 4;
+    int books = 5;
+    int64_t window = 3600;
+    float slack = 0.25;
+    bool rebalance = true;
+    for (int i = 1; i < argc; i++){
+        bool has_value = i+1 < argc;
+        if (!strcmp(argv[i], "--shards") && has_value) shards = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--fixtures") && has_value) params.fixtures = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--books") && has_value) books = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--window") && has_value) window = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--slack") && has_value) slack = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--skew") && has_value) params.bucket_skew = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--no-rebalance")) rebalance = false;
+        else if (!strcmp(argv[i], "--threads") && has_value) options.threads = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--min-roi") && has_value) options.min_roi = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && has_value) params.seed = strtoull(argv[++i], NULL, 10);
+        else {
+            std::cerr << "unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    params.teams = std::max<uint32_t>(200, params.fixtures/20);
+    params.kickoff_slots = std::max<uint32_t>(96, params.fixtures/100);
+
+    // the workers are forked before this process starts any thread
+    std::vector<std::string> paths;
+    std::vector<pid_t> workers;
+    for (uint32_t k = 0; k < shards; k++){
+        paths.push_back(fmt::format("/tmp/ays_shard_{}_{}.sock", (int)getpid(), k));
+        int fd = AYS_unix_listen(paths.back());
+        if (fd < 0) return 1;
+        pid_t pid = fork();
+        if (pid == 0){
+            bool ok = AYS_shard_serve(fd, options);
+            close(fd);
+            _exit(ok ? 0 : 1);
+        }
+        close(fd);
+        workers.push_back(pid);
+    }
+    int result = 0;
+    {
+        AYS_shard_coordinator coordinator(window, slack);
+        coordinator.rebalance = rebalance;
+        if (!AYS_shard_connect(coordinator, paths)){
+            result = 1;
+        }
+        AYS_clock clock;
+        options.clock = &clock;
+        fmt::memory_buffer merged;
+        AYS_event_writer single(-1, AYS_OUTPUT_BINARY, std::numeric_limits<size_t>::max()); // kept in its buffer
+        time_t now = std::time(0);
+        for (int b = 0; result == 0 && b < books; b++){
+            AYS_market_params book_params = params;
+            book_params.seed = params.seed + b;
+            std::vector<AYS_fixture> book = AYS_synthetic_market(book_params, now);
+            AYS_clock_set(clock, now);
+            uint64_t moves = coordinator.map.moves;
+            merged.clear();
+            AYS_shard_clock::time_point start = AYS_shard_clock::now();
+            int64_t events = AYS_shard_scan(coordinator, book, now, merged);
+            double sharded_ns = std::chrono::duration<double, std::nano>(AYS_shard_clock::now()-start).count();
+            if (events < 0){
+                result = 1;
+                break;
+            }
+            start = AYS_shard_clock::now();
+            std::vector<AYS_event> reference = AYS_fixtures_to_events(book, options);
+            double single_ns = std::chrono::duration<double, std::nano>(AYS_shard_clock::now()-start).count();
+            single.buffer.clear();
+            for (auto it = reference.rbegin(); it != reference.rend(); ++it){
+                AYS_writer_append(single, *it);
+            }
+            bool same = AYS_shard_same(AYS_shard_records(merged), AYS_shard_records(single.buffer));
+            std::string loads;
+            for (auto& link : coordinator.links){
+                loads += fmt::format("{}{}", loads.empty() ? "" : ",", link->routed.size());
+            }
+            std::cout << fmt::format("{{\"book\":{},\"fixtures\":{},\"events\":{},\"same\":{},\"sharded_ns\":{:.0f},\"single_ns\":{:.0f},"
+                                     "\"shard_fixtures\":[{}],\"moved\":{},\"pinned\":{}}}\n", b, book.size(), events, same,
+                                     sharded_ns, single_ns, loads, coordinator.map.moves - moves, coordinator.map.pinned.size());
+            result = same ? 0 : 1;
+        }
+    } // closing the links ends the workers
+    for (pid_t pid : workers){
+        int status;
+        if (result != 0) kill(pid, SIGTERM); // a worker may still wait for its coordinator
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) result = 1;
+    }
+    for (auto& path : paths){
+        unlink(path.c_str());
+    }
+    return result;
+}
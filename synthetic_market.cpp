@@ -0,0 +1,236 @@
+#include "are_you_sure.cpp"
+#include <cmath>
+#include <unordered_set>
+
+/*
+ * Synthetic market generator for the example and the benchmarks.
+ * A set of underlying matches is drawn first, then every provider quotes a subset of them with its own margin
+ * and its own spelling of the team names. Everything comes from a splitmix64 stream seeded with params.seed
+ * so a seed gives the same book on every platform, only the times are relative to now.
+ * Team names are unique within a sport and a team plays one match per kickoff slot of its sport, so two
+ * matches never share a team within a bucket and the only arbs are the ones the providers' odds make.
+ * A slot without enough free teams passes its matches on to the next one, past kickoff_slots if needed.
+ */
+struct AYS_market_params {
+    uint32_t fixtures;
+    uint32_t providers;
+    uint32_t sports;
+    uint32_t teams; // per sport
+    uint32_t min_participants;
+    uint32_t max_participants;
+    float alias_noise; // probability that a provider spells a team differently
+    float quote_rate; // probability that a provider quotes a match
+    float odds_noise; // width of the relative disagreement between providers, arbs get rare below the margins
+    uint32_t kickoff_slots;
+    float bucket_skew; // zipf exponent over the kickoff slots, 0 is uniform
+    float expired_rate; // fixtures that already expired
+    float live_rate; // fixtures that already started
+    uint64_t seed;
+    AYS_market_params(uint32_t fixtures = 100)
+        : fixtures(fixtures)
+        , providers(4)
+        , sports(3)
+        , teams(200)
+        , min_participants(2)
+        , max_participants(3)
+        , alias_noise(0.3)
+        , quote_rate(0.75)
+        , odds_noise(0.12)
+        , kickoff_slots(96)
+        , bucket_skew(1)
+        , expired_rate(0.05)
+        , live_rate(0.05)
+        , seed(1) { }
+};
+
+struct AYS_rng {
+    uint64_t state;
+    AYS_rng(uint64_t seed) : state(seed) { }
+    uint64_t next(){
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    uint32_t below(uint32_t n){
+        return n ? next() % n : 0;
+    }
+    float uniform(){
+        return (next() >> 40) / (float)(1 << 24);
+    }
+};
+
+std::string AYS_synthetic_team(AYS_rng &rng){
+    static const char *prefixes[] = {"FC ", "AC ", "IF ", "SK ", "", "", "", "Real ", "Sporting ", "Dynamo "};
+    static const char *syllables[] = {"bro", "kø", "ben", "havn", "by", "ama", "ger", "lyn", "vik", "holm",
+                                      "ster", "dal", "borg", "mar", "sund", "vej", "lev", "ager", "fred", "nor"};
+    std::string name = prefixes[rng.below(10)];
+    int n = 2 + rng.below(3);
+    for (int i = 0; i < n; i++){
+        std::string s = syllables[rng.below(20)];
+        if (i == 0) s[0] = std::toupper((unsigned char)s[0]);
+        name += s;
+    }
+    return name;
+}
+
+// the bytes [first, last) of the UTF-8 code point holding byte i
+void AYS_utf8_span(const std::string &s, size_t i, size_t &first, size_t &last){
+    first = i;
+    while (first > 0 && (s[first] & 0xC0) == 0x80) first--;
+    last = i+1;
+    while (last < s.size() && (s[last] & 0xC0) == 0x80) last++;
+}
+
+// a provider's spelling of a team, a light edit that stays well within the matching cutoff
+// the edits work on whole code points so an alias stays valid UTF-8
+std::string AYS_synthetic_alias(const std::string &team, AYS_rng &rng){
+    std::string alias = team;
+    size_t first, last;
+    switch (rng.below(4)){
+        case 0: // case change, ASCII only
+            for (auto& c : alias) c = std::tolower((unsigned char)c);
+            break;
+        case 1: // dropped prefix/character
+            if (alias.size() > 6){
+                AYS_utf8_span(alias, rng.below(alias.size()), first, last);
+                alias.erase(first, last-first);
+            }
+            break;
+        case 2: // abbreviation dot
+            if (alias.size() > 8){
+                AYS_utf8_span(alias, alias.size()-1, first, last);
+                alias.replace(first, last-first, 1, '.');
+            }
+            break;
+        default: // substitution
+            AYS_utf8_span(alias, rng.below(alias.size()), first, last);
+            alias.replace(first, last-first, 1, 'a' + rng.below(26));
+            break;
+    }
+    return alias;
+}
+
+std::vector<std::string> AYS_synthetic_provider_names(const AYS_market_params &params){
+    std::vector<std::string> names;
+    for (uint32_t pid = 0; pid < params.providers; pid++){
+        names.push_back(fmt::format("prov{}", pid));
+    }
+    return names;
+}
+
+std::vector<AYS_fixture> AYS_synthetic_market(const AYS_market_params &params, time_t now){
+    AYS_rng rng(params.seed);
+    std::vector<std::vector<std::string>> teams(params.sports);
+    for (auto& sport_teams : teams){
+        std::unordered_set<std::string> drawn; // two teams of a sport never share a name
+        while (sport_teams.size() < params.teams){
+            std::string team = AYS_synthetic_team(rng);
+            if (drawn.insert(team).second) sport_teams.push_back(team);
+        }
+    }
+    // alias of every (provider, sport, team), fixed for the whole book like real provider feeds
+    std::vector<std::string> aliases(params.providers*params.sports*params.teams);
+    for (uint32_t pid = 0; pid < params.providers; pid++){
+        for (uint32_t sid = 0; sid < params.sports; sid++){
+            for (uint32_t t = 0; t < params.teams; t++){
+                const std::string &team = teams[sid][t];
+                aliases[(pid*params.sports + sid)*params.teams + t] = rng.uniform() < params.alias_noise ? AYS_synthetic_alias(team, rng) : team;
+            }
+        }
+    }
+    std::vector<double> slot_cdf(params.kickoff_slots);
+    double total = 0;
+    for (uint32_t k = 0; k < params.kickoff_slots; k++){
+        total += 1/std::pow(k+1., params.bucket_skew);
+        slot_cdf[k] = total;
+    }
+    std::vector<float> margins(params.providers);
+    for (auto& margin : margins){
+        margin = 0.02 + 0.06*rng.uniform();
+    }
+    // per sport and slot the teams already playing, and the next slot that may have room (itself if it has)
+    std::vector<std::vector<std::vector<uint8_t>>> playing(params.sports);
+    std::vector<std::vector<uint32_t>> free_teams(params.sports);
+    std::vector<std::vector<uint32_t>> next_slot(params.sports);
+
+    std::vector<AYS_fixture> fs;
+    fs.reserve(params.fixtures);
+    uint32_t id = 0;
+    int lines[] = {0,1000,2000,3000};
+    while (fs.size() < params.fixtures){
+        uint32_t sid = rng.below(params.sports);
+        uint32_t participants = params.min_participants + rng.below(params.max_participants-params.min_participants+1);
+        uint32_t slot = std::lower_bound(slot_cdf.begin(), slot_cdf.end(), rng.uniform()*total) - slot_cdf.begin();
+        slot = std::min(slot, params.kickoff_slots-1);
+        std::vector<uint32_t> &next = next_slot[sid];
+        while (true){
+            while (slot < next.size() && next[slot] != slot){
+                uint32_t up = next[slot];
+                if (up < next.size()) next[slot] = next[up]; // halves the walks to come
+                slot = up;
+            }
+            if (slot >= next.size()){
+                for (uint32_t k = next.size(); k <= slot; k++){
+                    next.push_back(k);
+                }
+                free_teams[sid].resize(slot+1, params.teams);
+                playing[sid].resize(slot+1);
+            }
+            if (free_teams[sid][slot] >= participants) break;
+            next[slot] = slot+1; // the few teams left are not worth revisiting the slot
+        }
+        std::vector<uint8_t> &taken = playing[sid][slot];
+        taken.resize(params.teams);
+        time_t start_time = now + 900*(slot+1);
+        int line = lines[rng.below(4)];
+        std::vector<uint32_t> match_teams;
+        while (match_teams.size() < participants){
+            uint32_t t = rng.below(params.teams);
+            if (!taken[t]){
+                taken[t] = 1;
+                match_teams.push_back(t);
+            }
+        }
+        free_teams[sid][slot] -= participants;
+        std::vector<float> p(participants);
+        float sum = 0;
+        for (auto& x : p){
+            x = 0.05 + rng.uniform();
+            sum += x;
+        }
+        for (auto& x : p){
+            x /= sum;
+        }
+        for (uint32_t pid = 0; pid < params.providers && fs.size() < params.fixtures; pid++){
+            if (rng.uniform() >= params.quote_rate) continue;
+            std::vector<uint32_t> order(match_teams);
+            for (uint32_t j = participants-1; j > 0; j--){ // providers list the teams in their own order
+                std::swap(order[j], order[rng.below(j+1)]);
+            }
+            std::vector<AYS_participant> pn(participants);
+            std::vector<AYS_odd> po(participants);
+            std::vector<AYS_odd> pno(participants);
+            for (uint32_t j = 0; j < participants; j++){
+                uint32_t k = std::find(match_teams.begin(), match_teams.end(), order[j]) - match_teams.begin();
+                float q = p[k]*(1 + params.odds_noise*(rng.uniform()-0.5f)); // the provider's view of the outcome
+                // with the margin on top both prices stay below an inverse odd of 1, ie. decimal odds above 1
+                float q_max = 0.99f/(1+margins[pid]);
+                q = std::min(q_max, std::max(1-q_max, q));
+                pn[j] = aliases[(pid*params.sports + sid)*params.teams + order[j]];
+                po[j] = q*(1+margins[pid]);
+                pno[j] = (1-q)*(1+margins[pid]);
+            }
+            time_t st = start_time;
+            time_t expiry = now + 3600 + rng.below(3600); // outlives a scan of the largest books
+            float r = rng.uniform();
+            if (r < params.expired_rate){
+                expiry = now - 1 - rng.below(60);
+            } else if (r < params.expired_rate + params.live_rate){
+                st = now - 60*rng.below(90);
+            }
+            fs.emplace_back(st, expiry, pid, id++, sid, participants, line, "DKK", 100.f + 10*rng.below(100), pn, pno, po);
+        }
+    }
+    return fs;
+}